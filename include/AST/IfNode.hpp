@@ -1,6 +1,7 @@
 #pragma once
 
 #include <AST/ASTNode.hpp>
+#include <atomic>
 
 namespace dua
 {
@@ -9,7 +10,7 @@ class IfNode : public ASTNode
 {
     // If a counter is not used, LLVM will assign numbers incrementally (for example then1, else2, condition3)
     //  which can be confusing, especially in nested expressions.
-    static int _counter;
+    static std::atomic<int> _counter;
 
     std::vector<ASTNode*> conditions;
     // If branches.size() == conditions.size() + 1, branches.back() is the
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "AST/ASTNode.hpp"
+#include <atomic>
 
 namespace dua
 {
@@ -9,7 +10,7 @@ class ForNode : public ASTNode
 {
     // If a counter is not used, LLVM will assign numbers incrementally (for example for_cond1, for_body2, for_end3)
     //  which can be confusing, especially in nested expressions.
-    static int _counter;
+    static std::atomic<int> _counter;
 
     std::vector<ASTNode*> initializations;
     ASTNode* cond_exp;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "AST/ASTNode.hpp"
+#include <atomic>
 
 namespace dua
 {
@@ -9,7 +10,7 @@ class WhileNode : public ASTNode
 {
     // If a counter is not used, LLVM will assign numbers incrementally (for example while_cond1, while_body2, while_end3)
     //  which can be confusing, especially in nested expressions.
-    static int _counter;
+    static std::atomic<int> _counter;
 
     ASTNode* cond_exp;
     ASTNode* body_exp;
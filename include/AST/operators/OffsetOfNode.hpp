@@ -30,17 +30,10 @@ public:
             );
         }
 
-        auto& fields = class_type->fields();
         // 0 is invalid index since it points to the vtable pointer, which is an implementation details
-        size_t index = 0;
-        for (size_t i = 0; i < fields.size(); i++) {
-            if (fields[i].name == field_name) {
-                index = i;
-                break;
-            }
-        }
+        int index = class_type->get_field_index(field_name);
 
-        if (index == 0)
+        if (index <= 0)
             compiler->report_error("The class " + class_type->name + " has no field with the name " + field_name);
 
         auto type = class_type->llvm_type();
@@ -21,10 +21,8 @@ public:
 
     Value eval() override
     {
-        llvm::DataLayout dl(&module());
-
-        auto type = target_type->llvm_type();
-        if (type == nullptr) {
+        auto sized_type = target_type;
+        if (target_type->llvm_type() == nullptr) {
             // This can happen for example in the case sizeof(x).
             //  This will leave the parser confused about whether
             //  x is a variable name (an expression), or a class
@@ -33,10 +31,11 @@ public:
             auto cls = target_type->as<ClassType>();
             if (cls == nullptr)
                 compiler->report_internal_error("sizeof operator called on an invalid type");
-            type = name_resolver().symbol_table.get(cls->name).type->llvm_type();
+            sized_type = name_resolver().symbol_table.get(cls->name).type;
         }
 
-        long long size = (type->isSized()) ? dl.getTypeSizeInBits(type) / 8 : 0;
+        auto size_info = typing_system().get_size_info(sized_type);
+        long long size = size_info.is_sized ? size_info.size_in_bits / 8 : 0;
         return compiler->create_value(builder().getInt64(size), get_type());
     }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <AST/values/ValueNode.hpp>
+#include <atomic>
 
 namespace dua
 {
@@ -10,7 +11,7 @@ class StringValueNode : public ValueNode
 
     std::string value;
 
-    static int counter;
+    static std::atomic<int> counter;
 
 public:
 
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+namespace dua
+{
+
+// An index over the chunks of the libdua declarations that is built once
+//  per process, and is shared between all the modules. Instead of appending
+//  the whole library to every module, only the chunks that are referenced by
+//  the module (directly, or through other chunks) are appended, so that small
+//  files don't pay the cost of parsing the whole library.
+class LibduaIndex
+{
+    struct Chunk
+    {
+        // The names declared at the top level of the chunk
+        std::unordered_set<std::string> declared_names;
+
+        // The indices of the chunks needed by this chunk, including
+        //  itself, directly or indirectly, in ascending order
+        std::vector<size_t> needed_chunks;
+
+        bool declares_string = false;
+    };
+
+    std::vector<Chunk> chunks;
+
+    LibduaIndex();
+
+public:
+
+    static const LibduaIndex& get();
+
+    // Returns the declarations needed by the given code, in the
+    //  same order they appear in the libdua declarations
+    std::string get_needed_declarations(const std::string& code) const;
+
+    size_t chunk_count() const { return chunks.size(); }
+
+    // Returns the chunk along with the chunks it needs, in the same
+    //  order they appear in the libdua declarations. The result has
+    //  to compile on its own, otherwise, a dependency is missed.
+    std::string get_chunk_declarations(size_t chunk) const;
+};
+
+// The chunks of the declarations of libdua, in order
+std::vector<std::string>& get_libdua_declarations();
+
+}
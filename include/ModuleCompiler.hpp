@@ -8,6 +8,7 @@
 #include <resolution/NameResolver.hpp>
 #include <TypingSystem.hpp>
 #include <Value.hpp>
+#include <utils/Arena.hpp>
 #include <resolution/TemplatedNameResolver.hpp>
 
 namespace dua
@@ -15,6 +16,8 @@ namespace dua
 
 class ASTNode;
 class ParserAssistant;
+class InstantiationRegistry;
+struct ProgramInfo;
 
 class ModuleCompiler
 {
@@ -32,20 +35,27 @@ public:
     friend class ClassType;
     friend class ParserFacade;
 
-    ModuleCompiler(std::string module_name, std::string code, bool include_libdua = true);
+    // If a registry is provided, the template instances that are owned by other
+    //  modules of the build can later be turned into declarations. If the
+    //  information of the program is provided, the method calls that it proves
+    //  to have only one target are called directly instead of using the vtable.
+    ModuleCompiler(std::string module_name, std::string code, bool include_libdua = true,
+                   InstantiationRegistry* instantiation_registry = nullptr, bool whole_program = false,
+                   const ProgramInfo* program = nullptr);
 
-    const std::string& get_result() { return result; }
+    // Prints the module. Prefer emitting the module
+    //  directly if the text is not needed.
+    const std::string& get_result();
 
     template <typename T, typename ...Args>
     T* create_node(Args ...args) {
-        auto node = new T(this, args...);
-        nodes.push_back(node);
-        return node;
+        nodes_count++;
+        return arena.create<T>(this, args...);
     }
 
     template <typename T, typename ...Args>
-    const T* create_type(Args ...args) {
-        return typing_system.create_type<T>(args...);
+    const T* create_type(Args&& ...args) {
+        return typing_system.create_type<T>(std::forward<Args>(args)...);
     }
 
     Value create_value(llvm::Value* value, const Type* type, llvm::Value* memory_location = nullptr) {
@@ -126,7 +136,25 @@ public:
 
     const std::string& get_code() const { return code; }
 
-    ~ModuleCompiler();
+    // Records the definition of the function in the registry
+    //  if it's a template instance that may be shared
+    void add_function_definition(const std::string& name);
+
+    // Turns the template instances that are owned by other modules of the build
+    //  into declarations. Called once all the modules of the build are generated.
+    void declare_instances_owned_elsewhere();
+
+    // Whether the dynamic type of an object held by value can differ from its
+    //  static type, which is the case unless _set_vtable is known not to be
+    //  used anywhere in the program.
+    bool may_change_vtables() const;
+
+    // Whether the module sees all the subclasses of its classes
+    bool knows_all_subclasses() const;
+
+    // Whether no class of the program derives from the class, in which case
+    //  an object of the class, even behind a reference, is of the class itself.
+    bool is_leaf_class(const ClassType* cls) const;
 
 private:
 
@@ -139,6 +167,12 @@ private:
 
     std::string code;
 
+    InstantiationRegistry* instantiation_registry = nullptr;
+    // The template instances defined by the module, if a registry is provided
+    std::vector<std::string> template_instances;
+
+    const ProgramInfo* program = nullptr;
+
     ParserAssistant* parser_assistant;
 
     // Its insertion point is not guaranteed to be anywhere
@@ -170,6 +204,10 @@ private:
     std::vector<llvm::BasicBlock*> continue_stack;
     std::vector<llvm::BasicBlock*> break_stack;
 
+    // Owns the nodes, the types, and the resolution strings. It's declared
+    //  before the components that allocate from it, so that it outlives them.
+    Arena arena;
+
     // Used to resolve names of identifiers, whether
     //  it's a variable or a function/method
     NameResolver name_resolver;
@@ -177,8 +215,7 @@ private:
     // Used to create types, check for types, and convert between types
     TypingSystem typing_system;
 
-    // Used to track allocated nodes to delete later
-    std::vector<ASTNode*> nodes;
+    size_t nodes_count = 0;
 
     // Used to keep track of the number of scopes used within a function, in
     //  order to determine how many scopes to destruct upon a return instruction
@@ -223,6 +260,15 @@ public:
     //  the parsing stage (at which the classes are defined while parsing) is done or not, so
     //  that it knows whether it needs to define the class manually or not
     bool done_parsing = false;
+
+    // If true, the module is linked with the rest of the program and optimized as a whole.
+    //  The vtables and the virtual calls get the type metadata that the whole program
+    //  devirtualization pass needs to turn the virtual calls into direct calls.
+    const bool whole_program = false;
+
+    // Whether the _set_vtable operator is used in the module. The rest of the
+    //  program is accounted for by may_change_vtables.
+    bool uses_set_vtable = false;
 };
 
 }
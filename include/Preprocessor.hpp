@@ -1,20 +1,104 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <unordered_set>
+#include <llvm/Support/MemoryBuffer.h>
 
 namespace dua
 {
 
+// The preprocessed code, as a list of slices of the files that make it
+//  up. The files are memory mapped, and the code is only copied once,
+//  when the slices are joined into the string that gets compiled.
+class SourceBuffer
+{
+public:
+
+    struct Slice
+    {
+        size_t file;
+        size_t offset;
+        size_t length;
+    };
+
+    // Returns the index of the file, which the slices refer to
+    size_t add_file(std::shared_ptr<const llvm::MemoryBuffer> file);
+    void append(size_t file, size_t offset, size_t length);
+
+    [[nodiscard]] std::string_view get_file_text(size_t file) const;
+    [[nodiscard]] std::string_view get_text(const Slice& slice) const;
+    [[nodiscard]] const std::vector<Slice>& get_slices() const { return slices; }
+    [[nodiscard]] size_t size() const { return total_size; }
+
+    [[nodiscard]] std::string str() const;
+
+private:
+
+    std::vector<std::shared_ptr<const llvm::MemoryBuffer>> files;
+    std::vector<Slice> slices;
+    size_t total_size = 0;
+};
+
+// The imports of each file, along with the text between them. The graph is
+//  shared by the preprocessors of a build, which can run concurrently, so
+//  that each imported file is read and scanned for imports only once, no
+//  matter how many files of the build import it.
+class ImportGraph
+{
+public:
+
+    struct Segment
+    {
+        // Empty if this segment is a piece of the text of the file
+        std::string import_path;
+        size_t offset = 0;
+        size_t length = 0;
+    };
+
+    struct Node
+    {
+        std::shared_ptr<const llvm::MemoryBuffer> content;
+        // In the order of appearance
+        std::vector<Segment> segments;
+    };
+
+    // The path has to be a full path. Reads and scans the file on the first request.
+    const Node& get_file(const std::string& path);
+
+    // The import paths are resolved relative to the directory of the file
+    static Node scan(std::shared_ptr<const llvm::MemoryBuffer> content, const std::string& path);
+
+private:
+
+    std::mutex mutex;
+    std::unordered_map<std::string, std::unique_ptr<Node>> nodes;
+};
+
+// Replaces the imports with the contents of the imported files, where the
+//  import paths are relative to the directory of the importing file. It
+//  doesn't touch the working directory of the process, thus, multiple
+//  preprocessors can run concurrently. If a graph is provided, the imported
+//  files are shared with the other preprocessors that use the same graph.
 class Preprocessor
 {
     std::unordered_set<std::string> imported;
+    ImportGraph own_graph;
+    ImportGraph* graph;
 
-    std::string _process(const std::string& filename, const std::string& content);
+    void _process(SourceBuffer& result, const std::string& path, const ImportGraph::Node& node, bool is_import);
 
 public:
 
+    explicit Preprocessor(ImportGraph* graph = nullptr) : graph(graph ? graph : &own_graph) {}
+
+    SourceBuffer process_file(const std::string& filename);
+
     std::string process(const std::string& filename, const std::string& content);
 };
 
-}
\ No newline at end of file
+}
@@ -30,26 +30,33 @@ template<typename T, typename Key = std::string>
 struct Scope
 {
     ModuleCompiler* compiler;
-    // A vector is used here because the number
-    //  of elements is usually small to an extent
-    //  that the overhead of an std::map is bigger
-    //  than just performing a linear search.
-    // Also, to not store additional information to
-    //  retain the orders of insertion, which will
-    //  be needed for example when destructing a scope.
+    // The entries are kept in the order of insertion,
+    //  which is needed for example when destructing
+    //  a scope. The index maps each symbol to its
+    //  position in the map, so that lookups don't
+    //  have to scan the whole scope, which matters for
+    //  scopes with thousands of symbols, like the global
+    //  scope of generated files. Erased entries stay in
+    //  the map (see is_erased) until they make up half
+    //  of it, so that erasing doesn't shift the entries.
     std::vector<ScopeEntry<T, Key>> map;
-    std::vector<ScopeEntry<T, Key>> moved_symbols;
+    std::unordered_map<Key, size_t> index;
+    std::unordered_map<Key, T> moved_symbols;
+    size_t erased_count = 0;
 
     Scope(ModuleCompiler* compiler) : compiler(compiler) {}
 
-    Scope(const Scope& scope) : compiler(scope.compiler), map(scope.map) {}
+    Scope(const Scope& scope) : compiler(scope.compiler), map(scope.map), index(scope.index), erased_count(scope.erased_count) {}
 
-    Scope(Scope&& scope) : compiler(scope.compiler), map(std::move(scope.map)) {}
+    Scope(Scope&& scope) : compiler(scope.compiler), map(std::move(scope.map)), index(std::move(scope.index)),
+                           erased_count(scope.erased_count) {}
 
     Scope& operator=(const Scope& scope) {
         if (&scope != this) {
             compiler = scope.compiler;
             map = scope.map;
+            index = scope.index;
+            erased_count = scope.erased_count;
         }
         return *this;
     }
@@ -58,16 +65,31 @@ struct Scope
         if (&scope != this) {
             compiler = scope.compiler;
             map = std::move(scope.map);
+            index = std::move(scope.index);
+            erased_count = scope.erased_count;
         }
         return *this;
     }
 
+    // Whether the entry at the position of the map is erased, in which
+    //  case it has to be skipped when iterating over the map.
+    bool is_erased(size_t position) const
+    {
+        auto it = index.find(map[position].symbol);
+        return it == index.end() || it->second != position;
+    }
+
     size_t insertion_order(const Key& symbol) const
     {
-        for (size_t i = 0; i < map.size(); i++)
-            if (map[i].symbol == symbol)
-                return i;
-        return -1;
+        auto it = index.find(symbol);
+        return it == index.end() ? (size_t)-1 : it->second;
+    }
+
+    // Returns nullptr if the symbol is not in the scope
+    T* find(const Key& symbol)
+    {
+        auto it = index.find(symbol);
+        return it == index.end() ? nullptr : &map[it->second].value;
     }
 
     T& get(const Key& symbol) {
@@ -79,55 +101,71 @@ struct Scope
         if (contains(symbol)) {
             report_error("The symbol " + to_string(symbol) + " is already defined", compiler);
         }
-        for (size_t i = 0; i < moved_symbols.size(); i++) {
-            if (moved_symbols[i].symbol == symbol) {
-                moved_symbols.erase(moved_symbols.begin() + i);
-                break;
-            }
-        }
+        moved_symbols.erase(symbol);
+        index.emplace(symbol, map.size());
         map.push_back({symbol, t});
         return *this;
     }
 
     void erase(const Key& symbol) {
-        map.erase(map.begin() + get_valid_index(symbol));
+        erase_at(get_valid_index(symbol));
     }
 
     void move_erase(const Key& symbol)
     {
-        auto index = get_valid_index(symbol);
-        auto entry = std::move(map[index]);
-        map.erase(map.begin() + index);
-        for (size_t i = 0; i < moved_symbols.size(); i++) {
-            if (moved_symbols[i].symbol == entry.symbol) {
-                moved_symbols[i] = std::move(entry);
-                return;
-            }
-        }
-        moved_symbols.push_back(std::move(entry));
+        auto position = get_valid_index(symbol);
+        moved_symbols.insert_or_assign(symbol, std::move(map[position].value));
+        erase_at(position);
     }
 
     bool contains(const Key& symbol) const {
-        return insertion_order(symbol) != (size_t)-1;
+        return index.find(symbol) != index.end();
     }
 
-    bool is_move_erased(const Key& symbol) const
-    {
-        for (size_t i = 0; i < moved_symbols.size(); i++) {
-            if (moved_symbols[i].symbol == symbol) {
-                return true;
-            }
-        }
-        return false;
+    bool is_move_erased(const Key& symbol) const {
+        return moved_symbols.find(symbol) != moved_symbols.end();
     }
 
 private:
 
     size_t get_valid_index(const Key& symbol) const {
-        size_t index = insertion_order(symbol);
-        if (index == (size_t)-1)
+        size_t position = insertion_order(symbol);
+        if (position == (size_t)-1)
             report_error("The symbol " + to_string(symbol) + " is not defined", compiler);
-        return index;
+        return position;
+    }
+
+    // Usually, the erased symbol is the last one inserted (e.g.
+    //  temporary expressions), which is removed right away. Other
+    //  entries are only marked erased, by removing them from the
+    //  index, and removed once they make up half of the map, which
+    //  keeps erasing O(1) amortized.
+    void erase_at(size_t position)
+    {
+        index.erase(map[position].symbol);
+        if (position + 1 == map.size()) {
+            map.pop_back();
+            return;
+        }
+
+        erased_count++;
+        if (erased_count * 2 > map.size())
+            compact();
+    }
+
+    void compact()
+    {
+        size_t size = 0;
+        for (size_t i = 0; i < map.size(); i++) {
+            if (is_erased(i))
+                continue;
+            if (size != i)
+                map[size] = std::move(map[i]);
+            index[map[size].symbol] = size;
+            size++;
+        }
+        map.erase(map.begin() + size, map.end());
+        erased_count = 0;
     }
 
 };
@@ -170,7 +208,7 @@ struct SymbolTable
 
         // Iterate over all but the last scope (taking include_global into consideration)
         for (int i = scopes.size() - scope_num; i >= 1 + !include_global; i--) {
-            if (scopes[i].contains(name))
+            if (auto value = scopes[i].find(name); value != nullptr)
             {
                 if (is_moved_in_higher_scope) {
                     report_warning("The variable " + to_string(name) +
@@ -179,16 +217,20 @@ struct SymbolTable
                        compiler
                     );
                 }
-                return scopes[i].get(name);
+                return *value;
             }
 
             is_moved_in_higher_scope |= scopes[i].is_move_erased(name);
         }
 
-        if (!scopes[!include_global].contains(name) && is_moved_in_higher_scope)
+        auto& last = scopes[!include_global];
+        if (auto value = last.find(name); value != nullptr)
+            return *value;
+
+        if (is_moved_in_higher_scope)
             report_error("The variable " + to_string(name) + " is moved and can't be referenced unless it's redefined again", compiler);
 
-        return scopes[!include_global].get(name);
+        return last.get(name);
     }
 
     T& get_global(const Key& name) {
@@ -238,6 +280,8 @@ struct SymbolTable
         return top;
     }
 
+    // The global scope is moved, not copied, between the states, so
+    //  switching to the global-only state for templates is O(1).
     void keep_only_last_n_scopes(size_t n, bool include_global_scope = true)
     {
         if ((n + include_global_scope) > scopes.size())
@@ -247,8 +291,10 @@ struct SymbolTable
 
         scopes.resize(n + include_global_scope, Scope<T, Key>(compiler));
 
+        // Only the symbols of the global scope are moved. Its
+        //  moved symbols are kept in the previous state.
         if (include_global_scope)
-            scopes[0] = switch_stack.back()[0];
+            scopes[0] = std::move(switch_stack.back()[0]);
 
         auto offset = switch_stack.back().size() - 1 - n;
         for (size_t i = include_global_scope; i < n; i++)
@@ -258,9 +304,8 @@ struct SymbolTable
     void restore_prev_state()
     {
         // Global scope is kept
-        auto global_scope = scopes.front();
+        switch_stack.back().front() = std::move(scopes.front());
         scopes = std::move(switch_stack.back());
-        scopes.front() = std::move(global_scope);
         switch_stack.pop_back();
     }
 
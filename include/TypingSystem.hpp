@@ -5,6 +5,12 @@
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
 #include <SymbolTable.hpp>
+#include <utils/Arena.hpp>
+#include <map>
+#include <tuple>
+#include <memory>
+#include <atomic>
+#include <type_traits>
 
 namespace dua
 {
@@ -12,12 +18,74 @@ namespace dua
 class ModuleCompiler;
 class Value;
 
+struct TypeSizeInfo
+{
+    bool is_sized;
+    uint64_t size_in_bits;
+    // The size including the padding, which is the distance between two consecutive elements
+    uint64_t alloc_size;
+    uint64_t alignment;
+};
+
+// The key of an argument of a type constructor in the interning tables.
+//  String literals are keyed by their content, not by their address.
+template <typename Arg>
+using intern_key_t = std::conditional_t<
+    std::is_same_v<std::decay_t<Arg>, const char*> || std::is_same_v<std::decay_t<Arg>, char*>,
+    std::string,
+    std::decay_t<Arg>
+>;
+
+struct InternTableBase
+{
+    virtual ~InternTableBase() = default;
+};
+
+// Maps the constructor arguments of T to its unique instance. The element
+//  types in the arguments are unique instances themselves, so comparing
+//  them is a pointer comparison. The transparent comparator allows lookups
+//  using a tuple of references to the arguments, without copying them.
+template <typename T, typename ...Keys>
+struct InternTable : public InternTableBase
+{
+    std::map<std::tuple<Keys...>, T*, std::less<>> instances;
+};
+
 class TypingSystem
 {
     friend class Value;
 
     ModuleCompiler* compiler;
+    // The arena of the compiler, which owns the types
+    Arena& arena;
     mutable std::unordered_map<std::string, Type*> type_cache;
+    // Keyed by the concrete types. Only sized types are memoized, since
+    //  a class type is unsized until the layout of its fields is constructed
+    mutable std::unordered_map<const Type*, TypeSizeInfo> size_infos;
+    // Indexed by intern_table_index
+    mutable std::vector<std::unique_ptr<InternTableBase>> intern_tables;
+
+    static std::atomic<size_t> intern_tables_count;
+
+    // A unique index for each table type, shared by all the compilers
+    template <typename Table>
+    static size_t intern_table_index()
+    {
+        static const size_t index = intern_tables_count++;
+        return index;
+    }
+
+    template <typename Table>
+    Table& get_intern_table() const
+    {
+        auto index = intern_table_index<Table>();
+        if (index >= intern_tables.size())
+            intern_tables.resize(index + 1);
+        auto& table = intern_tables[index];
+        if (table == nullptr)
+            table = std::make_unique<Table>();
+        return static_cast<Table&>(*table);
+    }
 
 public:
 
@@ -25,21 +93,39 @@ public:
 
     explicit TypingSystem(ModuleCompiler* compiler);
 
+    // Types are interned, such that there is only one instance of each
+    //  type, and most type comparisons are pointer comparisons. A type
+    //  is looked up by its constructor arguments first, which doesn't
+    //  allocate. Only on a miss, a temporary instance is constructed to
+    //  be looked up by its key, since different arguments (e.g. types
+    //  referring to the same class) can still result in the same type.
     template <typename T, typename ...Args>
-    T* create_type(Args ...args) const
+    T* create_type(Args&& ...args) const
     {
+        auto& table = get_intern_table<InternTable<T, intern_key_t<Args>...>>().instances;
+        auto it = table.find(std::forward_as_tuple(args...));
+        if (it != table.end())
+            return it->second;
+
         // This won't recurse deeply due to the nature of recursive types
         //  (like pointers), in which each layer (the type pointed to in
         //  the case of a pointer type) is created in this function.
         T t(compiler, args...);
         auto str = t.as_key();
-        auto it = type_cache.find(str);
+        auto cached = type_cache.find(str);
         T* result;
-        result = ((it != type_cache.end()) ? (T*)it->second : new T(compiler, args...));
-        type_cache[str] = result;
+        if (cached != type_cache.end()) {
+            result = (T*)cached->second;
+        } else {
+            result = arena.create<T>(compiler, args...);
+            type_cache[str] = result;
+        }
+        table.emplace(std::forward_as_tuple(args...), result);
         return result;
     }
 
+    [[nodiscard]] size_t get_interned_types_count() const { return type_cache.size(); }
+
     // Returns 0 if the types are similar. The more the types are dissimilar, the more the score is.
     [[nodiscard]] int similarity_score(const Type* t1, const Type* t2) const;
     [[nodiscard]] int type_list_similarity_score(const std::vector<const Type*>& l1,
@@ -51,6 +137,11 @@ public:
     [[nodiscard]] Value cast_as_bool(const Value& value, bool panic_on_failure=true) const;
     [[nodiscard]] bool is_castable(const Type *t1, const Type* t2) const;
 
+    // The layout of the module, which is shared by all the size queries,
+    //  and which caches the layouts of the structs it's queried about
+    [[nodiscard]] const llvm::DataLayout& data_layout() const;
+    [[nodiscard]] TypeSizeInfo get_size_info(const Type* type) const;
+
     [[nodiscard]] llvm::IRBuilder<>& builder() const;
     [[nodiscard]] llvm::Module& module() const;
 
@@ -60,8 +151,6 @@ public:
 
     void push_scope();
     Scope<const Type*> pop_scope();
-
-    ~TypingSystem();
 };
 
 }
\ No newline at end of file
@@ -47,6 +47,14 @@ public:
     std::vector<NamedFunctionValue> get_all_class_methods(const std::string& class_name);
     std::vector<TypeAliasNode*>& get_class_aliases(const std::string& class_name);
 
+    // Whether any of the classes known so far derives from the class
+    bool has_subclasses(const std::string& class_name) const;
+
+    // The implementations of the method (by its full name in the class) in the
+    //  vtables of the class and of all the classes that derive from it, which
+    //  are all the methods that a virtual call of the method can reach.
+    std::vector<llvm::Function*> get_method_implementations(const std::string& class_name, const std::string& method_name);
+
     virtual ~ClassResolver();
 };
 
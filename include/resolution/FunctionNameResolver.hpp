@@ -1,6 +1,8 @@
 #pragma once
 
 #include <map>
+#include <unordered_map>
+#include <optional>
 #include "types/FunctionType.hpp"
 #include "types/ClassType.hpp"
 #include <llvm/IR/IRBuilder.h>
@@ -19,6 +21,41 @@ class FunctionNameResolver
 {
     std::map<std::string, FunctionInfo> functions;
 
+    struct Overload
+    {
+        const std::string* name;
+        const FunctionType* type;
+    };
+
+    struct OverloadResolution
+    {
+        std::string winner;
+        // If there is no winner, whether there are no applicable
+        //  overloads, or there are multiple equally good ones
+        bool is_ambiguous = false;
+    };
+
+    // The overloads that a function call with a given name can resolve to
+    struct OverloadSet
+    {
+        // The function with the exact name, if registered without mangling
+        std::optional<Overload> non_mangled;
+        size_t mangled_count = 0;
+        // The non-variadic overloads, indexed by their number of parameters
+        std::vector<std::vector<Overload>> by_arity;
+        // Variadic overloads are applicable to any number of arguments
+        std::vector<Overload> var_arg;
+        // The results of the previous resolutions, keyed by the concrete argument types
+        std::map<std::vector<const Type*>, OverloadResolution> resolutions;
+    };
+
+    // Built lazily for each looked up name, and dropped whenever
+    //  a function that can be resolved through the name is registered
+    mutable std::unordered_map<std::string, OverloadSet> overload_sets;
+
+    OverloadSet& get_overload_set(const std::string& name) const;
+    void invalidate_overload_sets(const std::string& full_name);
+
     void cast_function_args(std::vector<Value>& args, const FunctionType* type) const;
     void report_function_not_defined(const std::string& name);
 
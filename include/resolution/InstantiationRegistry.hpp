@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+namespace dua
+{
+
+// Shared by the modules of one build whose outputs get linked together,
+//  so that each template instance (a function or a method named with the
+//  "Templated." prefix) is only defined by one of them. Every module defines
+//  the instances it uses, and once all of them are generated, each instance
+//  is owned by the first module of the build (in the order of the files) that
+//  defines it, so the owners don't depend on the scheduling of the modules.
+class InstantiationRegistry
+{
+    std::mutex mutex;
+    // The position of each module in the build
+    std::unordered_map<std::string, size_t> module_indices;
+    // Maps the name of an instance to the index of its owner module
+    std::unordered_map<std::string, size_t> owners;
+
+public:
+
+    explicit InstantiationRegistry(const std::vector<std::string>& module_names);
+
+    static bool is_template_instance(const std::string& function_name);
+
+    // Records that the module defines the instance
+    void add_definition(const std::string& function_name, const std::string& module_name);
+
+    // Returns whether the module owns the instance. Only meaningful after
+    //  all the modules of the build have added their definitions.
+    bool is_owner(const std::string& function_name, const std::string& module_name);
+};
+
+}
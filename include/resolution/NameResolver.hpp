@@ -6,6 +6,7 @@
 #include <resolution/TemplatedNameResolver.hpp>
 #include <resolution/CommonStructs.hpp>
 #include <resolution/ResolutionString.hpp>
+#include <utils/Arena.hpp>
 
 
 namespace dua
@@ -21,7 +22,9 @@ public:
     ModuleCompiler* compiler;
 
     SymbolTable<Value> symbol_table;
-    std::vector<ResolutionString*> resolution_strings;
+
+    // The arena of the compiler, which owns the resolution strings
+    Arena& arena;
 
     explicit NameResolver(ModuleCompiler* compiler);
 
@@ -31,12 +34,8 @@ public:
 
     template<typename T, typename ...Args>
     ResolutionString* create_resolution_string(Args ...args) {
-        auto result = new T(compiler, args...);
-        resolution_strings.push_back(result);
-        return result;
+        return arena.create<T>(compiler, args...);
     }
-
-    ~NameResolver();
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace dua
+{
+
+// What is known about the whole program that the modules of a build are linked
+//  into, gathered from the preprocessed code of all of its Dua files before any
+//  of them is compiled. A module that is compiled without it (e.g. using -c, to
+//  be linked with other Dua objects later) can't rely on any of it.
+struct ProgramInfo
+{
+    // Whether any of the files uses the _set_vtable operator, which
+    //  can change the dynamic type of any object, even one that is
+    //  held by value, possibly from another file.
+    bool uses_set_vtable = false;
+
+    // Whether the program has only one Dua module, other than libdua, which thus
+    //  sees all the subclasses of its classes. libdua is not a concern, since
+    //  its classes are declared along with their subclasses, and it doesn't
+    //  hand out objects of its classes through references to their parents.
+    bool is_single_module = false;
+
+    static ProgramInfo from_code(const std::vector<std::string>& code);
+};
+
+}
@@ -6,6 +6,8 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
+#include <map>
+#include <tuple>
 
 namespace dua
 {
@@ -32,6 +34,27 @@ class TemplatedNameResolver
 
     std::unordered_map<std::string, TemplatedClassInfo> registered_templated_classes;
 
+    struct TemplatedFunctionInstance
+    {
+        size_t overload;
+        llvm::Function* function;
+        const FunctionType* type;
+    };
+
+    // The instances that are looked up before, keyed by the key of the templated function,
+    //  then by whether the argument types are used, the template args, and the argument types.
+    //  The types are interned, so comparing the keys is comparing pointers, and a lookup
+    //  that hits doesn't need to switch the scopes or build the full name of the instance.
+    using TemplatedFunctionInstanceKey = std::tuple<bool, std::vector<const Type*>, std::vector<const Type*>>;
+    std::unordered_map<std::string, std::map<TemplatedFunctionInstanceKey, TemplatedFunctionInstance, std::less<>>> templated_function_instances;
+    // Keyed by the key of the templated class, then by the template args
+    std::unordered_map<std::string, std::map<std::vector<const Type*>, const ClassType*>> templated_class_instances;
+
+    const TemplatedFunctionInstance* find_templated_function_instance(const std::string& key, bool use_arg_types,
+        const std::vector<const Type*>& template_args, const std::vector<const Type*>& arg_types) const;
+    void add_templated_function_instance(const std::string& key, bool use_arg_types, const std::vector<const Type*>& template_args,
+        const std::vector<const Type*>& arg_types, TemplatedFunctionInstance instance);
+
     void check_template_params(const std::vector<std::string>& template_params, const std::string& description = "");
 
 public:
@@ -51,6 +74,9 @@ public:
     std::string get_templated_class_key(std::string name, size_t args_count);
     std::string get_templated_class_full_name(const std::string& name, const std::vector<const Type*>& template_args);
     void add_templated_class(ClassDefinitionNode* node, std::vector<std::string> template_params, const IdentifierType* parent);
+    // Whether a templated class has a parent, other than Object, in which case
+    //  its instances become subclasses of their parents when instantiated.
+    bool has_templated_subclasses() const;
     void add_templated_class_method_info(const std::string& cls, FunctionDefinitionNode* method, FunctionInfo info, std::vector<std::string> template_params);
     TemplatedClassMethodInfo get_templated_class_method_info(const std::string& cls, const std::string& method, const FunctionType* type, size_t template_param_count);
     const ClassType* get_templated_class(const std::string& name, const std::vector<const Type*>& template_args);
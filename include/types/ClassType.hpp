@@ -2,6 +2,7 @@
 
 #include <types/Type.hpp>
 #include <llvm/IR/DerivedTypes.h>
+#include <unordered_map>
 
 namespace dua
 {
@@ -26,6 +27,11 @@ struct ClassField
 
 class ClassType : public Type
 {
+    // Looked up once, and kept in sync with the fields afterwards
+    llvm::StructType* struct_type;
+    mutable const std::vector<ClassField>* field_table = nullptr;
+    mutable std::unordered_map<std::string, size_t> field_indices;
+    mutable size_t indexed_fields_count = 0;
 
 public:
 
@@ -39,7 +45,8 @@ public:
     //  in between (Printer.print for example). This way, we make sure that
     //  user defined function names can't collide with the method names.
 
-    // The fields are stored and accessed through the compiler.
+    // The fields are stored through the compiler, and are accessed through the
+    //  class type, which keeps a reference to them and an index of their names.
 
     ClassType(ModuleCompiler* compiler, std::string name);
 
@@ -55,13 +62,25 @@ public:
 
     std::string as_key() const override { return name; }
 
+    // Returns -1 if the class has no field with the name
+    int get_field_index(const std::string& name) const;
+
     const ClassField& get_field(const std::string& name) const;
 
     Value get_field(const Value& instance, const std::string& name) const;
 
     Value get_field(const Value& instance, size_t index) const;
 
-    Value get_method(const std::string& name, Value instance, const std::vector<const Type*>& arg_types, bool panic_on_error = true) const;
+    // If is_exact_type is true, the dynamic type of the instance is known to be this class,
+    //  and the method is called directly instead of being loaded from the vtable. The
+    //  same goes for the classes that no class of the program derives from.
+    Value get_method(const std::string& name, Value instance, const std::vector<const Type*>& arg_types,
+                     bool panic_on_error = true, bool is_exact_type = false) const;
+
+    // Annotates the calls of a method that get_method loaded from the vtable with
+    //  !callees, listing the implementations that the calls can reach, if they're
+    //  all known. The optimizer can then call them directly, or inline them.
+    void add_callees_metadata(const Value& method, const std::string& name, const std::vector<const Type*>& arg_types) const;
 
     int ancestor_distance(const ClassType* ancestor) const;
 };
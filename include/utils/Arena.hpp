@@ -0,0 +1,67 @@
+#pragma once
+
+#include <new>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+
+namespace dua
+{
+
+// A bump-pointer allocator that owns the objects that live as long as the
+//  module compiler (AST nodes, types, and resolution strings). Allocating an
+//  object is a pointer bump, and all the memory is freed at once when the
+//  arena is destroyed. Objects that have a non-trivial destructor register
+//  it upon creation, and it's called in the reverse order of the creation.
+class Arena
+{
+    struct Destructor
+    {
+        void (*destroy)(void*);
+        void* object;
+    };
+
+    std::vector<char*> blocks;
+    std::vector<Destructor> destructors;
+    char* current = nullptr;
+    char* end = nullptr;
+    size_t next_block_size = 64 * 1024;
+    size_t allocated_size = 0;
+
+    void* allocate_in_new_block(size_t size, size_t alignment);
+
+public:
+
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t alignment)
+    {
+        auto address = (reinterpret_cast<uintptr_t>(current) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        auto result = reinterpret_cast<char*>(address);
+        if (current == nullptr || result + size > end)
+            return allocate_in_new_block(size, alignment);
+        current = result + size;
+        allocated_size += size;
+        return result;
+    }
+
+    template <typename T, typename ...Args>
+    T* create(Args&& ...args)
+    {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "Over-aligned types are not supported");
+        auto result = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>)
+            destructors.push_back({ [](void* object) { static_cast<T*>(object)->~T(); }, result });
+        return result;
+    }
+
+    [[nodiscard]] size_t get_allocated_size() const { return allocated_size; }
+
+    ~Arena();
+};
+
+}
@@ -1,14 +1,64 @@
 #pragma once
 
 #include <utils/VectorOperators.hpp>
+#include <utils/NativeBackend.hpp>
 
 namespace dua
 {
 
+struct CompilationOptions
+{
+    bool include_libdua = true;
+
+    // The number of files compiled in parallel. 0 means all the cores
+    size_t jobs = 1;
+
+    // Empty means the default target triple of the host
+    std::string target_triple;
+
+    OptimizationLevel optimization_level = OptimizationLevel::O0;
+
+    bool print_pipeline_timings = false;
+
+    // Where the outputs of the compiled modules are cached across builds.
+    //  Empty means the value of the DUA_CACHE environment variable if set,
+    //  or no caching otherwise.
+    std::string cache_directory;
+
+    // Print the time spent in each phase, per file and aggregated
+    bool time_report = false;
+
+    // Where to write a Chrome trace of the build. Empty means no trace
+    std::string time_trace_file;
+
+    // Whether the modules are linked together in the end, in which case
+    //  each template instance is defined by only one of the modules
+    bool share_template_instances = false;
+
+    // Link all the Dua files into one module in memory, and optimize
+    //  it as a whole, producing one output instead of one per file
+    bool whole_program = false;
+
+    // Whether the Dua files of the build are all the Dua files of the program,
+    //  which is the case when they're linked in the same invocation with no other
+    //  inputs. The modules can then rely on what is known about the whole program
+    //  (e.g. that _set_vtable isn't used) to call methods without the vtable.
+    bool has_all_dua_files = false;
+};
+
 std::string uuid();
-void generate_llvm_ir(const strings& filename, const strings& code, bool include_libdua = true);
+std::string get_program_location();
+void generate_llvm_ir(const strings& filename, const strings& code, bool include_libdua = true, size_t jobs = 1);
+void emit_modules(const strings& module_names, const strings& code, const strings& output_paths, OutputKind kind,
+                  const CompilationOptions& options = {});
+void emit_whole_program(const strings& module_names, const strings& code, const std::string& output_path, OutputKind kind,
+                        const CompilationOptions& options = {});
 int  run_clang(const std::vector<std::string>& args, bool include_libdua = true);
-bool run_clang_on_llvm_ir(const strings& filename, const strings& code, const strings& args, bool include_libdua = true, bool use_temp = true);
-void compile(const strings& source_files, const strings& args, bool include_libdua = true);
+bool run_clang_on_llvm_ir(const strings& filename, const strings& code, const strings& args, bool include_libdua = true, bool use_temp = true, size_t jobs = 1);
+void compile(const strings& source_files, const strings& args, CompilationOptions options = {});
+
+// Compiles the files and runs them in-process using a JIT, without producing
+//  an executable. Returns the exit code of the program.
+int  run(const strings& source_files, const strings& args, const strings& program_args, CompilationOptions options = {});
 
 }
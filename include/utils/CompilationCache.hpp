@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+namespace dua
+{
+
+// A content-addressed cache of compilation outputs, stored on the disk.
+//  The key of an output is a hash of everything that affects it (the
+//  preprocessed code, the compiler, the target, and the flags), so that
+//  unchanged modules can skip compilation entirely across builds.
+class CompilationCache
+{
+    std::filesystem::path directory;
+
+public:
+
+    explicit CompilationCache(const std::string& directory);
+
+    // Hashes the components, along with the identity of the compiler itself
+    static std::string compute_key(const std::vector<std::string>& components);
+
+    // Copies the cached output of the key to the output path, if present
+    bool fetch(const std::string& key, const std::string& extension, const std::string& output_path) const;
+
+    // Failing to store an output is not an error, it only results in a cache miss later
+    void store(const std::string& key, const std::string& extension, const std::string& output_path) const;
+};
+
+}
@@ -1,12 +1,22 @@
 #pragma once
 
 #include <string>
+#include <ostream>
+#include <stdexcept>
 
 namespace dua
 {
 
 class ModuleCompiler;
 
+// Thrown by report_error and report_internal_error, after the
+//  message is written to the diagnostics stream. Whoever catches
+//  it doesn't need to print the message again.
+struct ReportedError : std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
 void report_error(const std::string& message);
 void report_internal_error(const std::string& message);
 void report_warning(const std::string& message);
@@ -15,4 +25,9 @@ void report_error(const std::string& message, ModuleCompiler* compiler);
 void report_internal_error(const std::string& message, ModuleCompiler* compiler);
 void report_warning(const std::string& message, ModuleCompiler* compiler);
 
-}
\ No newline at end of file
+// The stream the diagnostics of the calling thread are reported to.
+//  Defaults to std::cerr. Passing nullptr restores the default.
+std::ostream& diagnostics_stream();
+void set_diagnostics_stream(std::ostream* stream);
+
+}
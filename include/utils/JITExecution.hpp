@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <llvm/IR/Module.h>
+#include <utils/NativeBackend.hpp>
+
+namespace dua
+{
+
+// Links the modules together, and runs the main function in-process
+//  using an ORC LLJIT instance, without producing an executable. The
+//  modules can belong to different contexts, and are left untouched.
+//  The initializers of the modules (.dua.init) run before main, and the
+//  cleanup functions registered using atexit run after main returns.
+//  If whole_program is set, the linked program is optimized using the
+//  link-time optimization pipeline, the same way -whole-program does.
+//  If given, before_main is called once the program is compiled and
+//  initialized, right before main is called. If exit_function is given,
+//  the calls of the program to exit end up calling it with the exit code
+//  once the cleanup functions of the program run, instead of exiting.
+//  Returns the exit code of the program.
+int run_in_jit(const std::vector<const llvm::Module*>& modules, const std::string& program_name,
+               const std::vector<std::string>& program_args, bool include_libdua = true,
+               OptimizationLevel level = OptimizationLevel::O0, bool whole_program = false,
+               const std::function<void()>& before_main = {}, void (*exit_function)(int) = nullptr);
+
+}
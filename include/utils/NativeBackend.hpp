@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <llvm/IR/Module.h>
+#include <llvm/Target/TargetMachine.h>
+
+namespace dua
+{
+
+enum class OutputKind
+{
+    LLVM_IR,    // -S -emit-llvm
+    BITCODE,    // -c -emit-llvm
+    ASSEMBLY,   // -S
+    OBJECT,     // -c, or an intermediate file for linking
+};
+
+enum class OptimizationLevel
+{
+    O0, O1, O2, O3, Os, Oz
+};
+
+// Registers the targets LLVM is built with. It's safe to call it more than
+//  once, and it has to be called before creating any target machine.
+void initialize_native_backend();
+
+// An empty triple means the default target triple of the host
+std::unique_ptr<llvm::TargetMachine> create_target_machine(const std::string& target_triple = "",
+                                                           OptimizationLevel level = OptimizationLevel::O0);
+
+// Runs the default module pipeline of the new pass manager for the given
+//  level. If print_timings is set, a timing report of the executed passes
+//  is written to the diagnostics stream. If the module is the whole program,
+//  the link-time pipeline is used instead.
+void optimize_module(llvm::Module& module, llvm::TargetMachine& target_machine,
+                     OptimizationLevel level, bool print_timings = false, bool whole_program = false);
+
+// Emits the module directly from memory, without printing it and passing
+//  it to clang. The target triple and the data layout of the module are
+//  set to the ones of the target machine before emission.
+void emit_module(llvm::Module& module, llvm::TargetMachine& target_machine, OutputKind kind, const std::string& path);
+
+std::string get_output_extension(OutputKind kind);
+
+// Modules of different contexts can't be linked together, or used by
+//  another thread. This copies the module into the given context through
+//  an in-memory bitcode round trip.
+std::unique_ptr<llvm::Module> copy_module_to_context(const llvm::Module& module, llvm::LLVMContext& context);
+
+// Links copies of the modules into one module of the given context. The duplicate
+//  template instances (which use "any" comdats) are merged the same way the
+//  system linker merges them.
+std::unique_ptr<llvm::Module> link_modules(const std::vector<const llvm::Module*>& modules, const std::string& name,
+                                           llvm::LLVMContext& context);
+
+// Gives internal linkage to the definitions of a whole program module, except
+//  for the entry points (main, and the .dua.init and .dua.cleanup functions),
+//  and the vtable instances, which are compared by address with the ones of
+//  libdua when casting. This allows the optimizer to inline and drop them freely.
+void internalize_module(llvm::Module& module);
+
+}
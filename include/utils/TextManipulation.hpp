@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace dua
@@ -12,7 +13,10 @@ struct TestFile
     std::vector<std::string> cases;
 };
 
+// The line endings are normalized to \n
 std::string read_file(const std::string& name);
+// Replaces each \r\n with \n
+std::string normalize_line_endings(std::string_view text);
 std::string escape_characters(const std::string& str);
 
 // Testing files related functions
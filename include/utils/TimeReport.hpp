@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <chrono>
+
+namespace dua
+{
+
+struct PhaseTime
+{
+    double wall = 0;
+    // The CPU time of the thread, and of the subprocesses (e.g. clang)
+    double cpu = 0;
+};
+
+// The time spent in each compilation phase of a file, along with counters
+//  of the work done. The build-wide phases, such as linking, are recorded
+//  in a separate report, which is only included in the aggregated report.
+struct TimeReport
+{
+    std::string name;
+    // In the order in which they're first recorded
+    std::vector<std::pair<std::string, PhaseTime>> phases;
+    std::vector<std::pair<std::string, size_t>> counters;
+    // The phases being timed right now. A phase that recurses
+    //  (e.g. template instantiation) is only timed once.
+    std::vector<const char*> active_phases;
+
+    void add_time(const std::string& phase, PhaseTime time);
+    void add_to_counter(const std::string& counter, size_t n);
+    void merge(const TimeReport& other);
+    void print(std::ostream& stream) const;
+};
+
+// Both are disabled by default, in which case the timers
+//  and the counters are no-ops. Enable them before compiling.
+void enable_time_report();
+void enable_time_trace();
+bool is_time_report_enabled();
+bool is_time_trace_enabled();
+
+// Creates a report for each file, in the order of the files, replacing the
+//  reports of a previous build. Call it before compiling the files, since
+//  the reports are identified by the index of their file, not its name.
+void register_file_reports(const std::vector<std::string>& files);
+
+// Records the phases and the counters of the calling thread in the report of
+//  the file at the given index during its lifetime. If the time trace is
+//  enabled, it also sets up the trace of the calling thread if it's a worker.
+class FileTimeReportScope
+{
+    TimeReport* previous = nullptr;
+    bool finish_trace_thread = false;
+    bool active = false;
+
+public:
+
+    explicit FileTimeReportScope(size_t file);
+    FileTimeReportScope(const FileTimeReportScope&) = delete;
+    FileTimeReportScope& operator=(const FileTimeReportScope&) = delete;
+    ~FileTimeReportScope();
+};
+
+// Records its lifetime as the given phase in the report of the calling
+//  thread, and as an event in the time trace. The phase name has to be
+//  a string literal, since it identifies recursive phases by address.
+class PhaseTimer
+{
+    const char* phase;
+    TimeReport* report = nullptr;
+    bool traced = false;
+    std::chrono::steady_clock::time_point start_wall;
+    double start_cpu = 0;
+
+public:
+
+    explicit PhaseTimer(const char* phase);
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+    ~PhaseTimer();
+};
+
+// Adds n to the counter in the report of the calling thread
+void add_to_counter(const char* counter, size_t n = 1);
+
+// Prints the report of each file, followed by the aggregated report
+void print_time_reports(std::ostream& stream);
+
+// Writes the recorded events in the Chrome trace event format,
+//  which can be loaded in chrome://tracing or in Perfetto.
+void write_time_trace(const std::string& path);
+
+}
@@ -2,6 +2,7 @@
 #include <utils/termcolor.hpp>
 #include <iostream>
 #include <cstring>
+#include <charconv>
 #include <utils/TextManipulation.hpp>
 
 using namespace dua;
@@ -26,35 +27,82 @@ int main(int argc, char* argv[])
         {
             std::cout << "\nUSAGE: " <<
             termcolor::green << argv[0] <<
-            termcolor::reset << " [options] file...\n\n";
+            termcolor::reset << " [options] file...\n";
+
+            std::cout << "       " <<
+            termcolor::green << argv[0] <<
+            termcolor::reset << " run [options] file... [-- program arguments]\n\n";
 
             std::cout << "Popular Options:\n"
                          "  -S                      Generate assembly-code files (run compilation steps only)\n"
                          "  -c                      Generate object files\n"
                          "  -emit-llvm              Generate LLVM IR code files (used along with the -S flag)\n"
-                         "  --target=<value>        Generate code for the given target (<value> = target triple)\n\n";
+                         "  --target=<value>        Generate code for the given target (<value> = target triple)\n"
+                         "  -O<level>               Optimization level (<level> = 0, 1, 2, 3, s, or z)\n"
+                         "  -print-pipeline-timings Print the time taken by each optimization pass\n"
+                         "  -j<N>                   Compile up to N files in parallel (-j alone uses all the cores)\n"
+                         "  -whole-program          Link the Dua files in memory and optimize them as one program\n"
+                         "  --cache-dir=<dir>       Cache the compiled files in <dir> to skip unchanged files in later\n"
+                         "                          builds (defaults to the DUA_CACHE environment variable if set)\n"
+                         "  -dua-time-report        Print the time spent in each compilation phase, per file and in total\n"
+                         "  -dua-time-trace=<file>  Write a Chrome trace of the compilation phases to <file>\n\n";
 
-            std::cout << "Note: the Dua compiler is based on clang. This means that you can pass post-IR-generation "
-                         "clang options\n";
+            std::cout << "Note: Dua files are compiled in-process, and clang is used for linking and for compiling "
+                         "non-Dua input files. This means that you can pass clang options for these steps\n\n";
+
+            std::cout << "The run mode compiles the files and runs them in-process using a JIT, without invoking clang "
+                         "or producing an executable. Only the -O<level>, -j<N>, -no-libdua, and the time report options apply to it\n";
             return 0;
         }
     }
 
-    bool include_dua_lib = true;
+    // Dua run [options] file... [-- program arguments]
+    bool run_mode = std::strcmp(argv[1], "run") == 0;
+
+    CompilationOptions options;
     std::vector<std::string> args;
     std::vector<std::string> source_files;
-    for (int i = 1; i < argc; i++) {
+    std::vector<std::string> program_args;
+    for (int i = run_mode ? 2 : 1; i < argc; i++) {
+        if (run_mode && std::strcmp(argv[i], "--") == 0) {
+            program_args.assign(argv + i + 1, argv + argc);
+            break;
+        }
         if (is_dua_file(argv[i]))
             source_files.emplace_back(argv[i]);
         else {
             if (strcmp(argv[i], "-no-libdua") == 0)
-                include_dua_lib = false;
-            else
+                options.include_libdua = false;
+            else if (strcmp(argv[i], "-print-pipeline-timings") == 0)
+                options.print_pipeline_timings = true;
+            else if (strcmp(argv[i], "-whole-program") == 0)
+                options.whole_program = true;
+            else if (strncmp(argv[i], "--cache-dir=", 12) == 0)
+                options.cache_directory = argv[i] + 12;
+            else if (strcmp(argv[i], "-dua-time-report") == 0)
+                options.time_report = true;
+            else if (strncmp(argv[i], "-dua-time-trace=", 16) == 0)
+                options.time_trace_file = argv[i] + 16;
+            else if (strncmp(argv[i], "-j", 2) == 0) {
+                std::string count = argv[i] + 2;
+                // 0 means using all the available cores
+                size_t jobs = 0;
+                auto [end, error] = std::from_chars(count.data(), count.data() + count.size(), jobs);
+                if (!count.empty() && (error != std::errc() || end != count.data() + count.size())) {
+                    std::cerr << termcolor::red << "Fatal error" << termcolor::reset <<
+                        ": invalid number of jobs " << count << '\n';
+                    return 1;
+                }
+                options.jobs = jobs;
+            } else
                 args.emplace_back(argv[i]);
         }
     }
 
-    compile(source_files, args, include_dua_lib);
+    if (run_mode)
+        return run(source_files, args, program_args, options);
+
+    compile(source_files, args, options);
 
     return 0;
 }
\ No newline at end of file
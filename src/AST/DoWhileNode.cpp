@@ -3,7 +3,7 @@
 namespace dua
 {
 
-int DoWhileNode::_counter = 0;
+std::atomic<int> DoWhileNode::_counter = 0;
 
 NoneValue DoWhileNode::eval()
 {
@@ -3,7 +3,7 @@
 namespace dua
 {
 
-int ForNode::_counter = 0;
+std::atomic<int> ForNode::_counter = 0;
 
 NoneValue ForNode::eval()
 {
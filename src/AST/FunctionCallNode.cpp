@@ -40,10 +40,12 @@ Value FunctionCallNode::eval()
         //  in the loaded_value field, we need to move it back again to memory_location.
         instance.memory_location = instance.get();
         instance.set(nullptr);
-        auto method = class_type->get_method(_current_name, instance, std::move(arg_types), false);
+        auto method = class_type->get_method(_current_name, instance, arg_types, false);
         if (!method.is_null()) {
             evaluated_args.insert(evaluated_args.begin(), instance);
-            return name_resolver().call_function(method, std::move(evaluated_args));
+            auto result = name_resolver().call_function(method, std::move(evaluated_args));
+            class_type->add_callees_metadata(method, _current_name, arg_types);
+            return result;
         }
     }
 
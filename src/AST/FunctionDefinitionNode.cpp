@@ -49,6 +49,8 @@ Value FunctionDefinitionNode::define_function()
 
     if (is_static)
         function->setLinkage(llvm::Function::InternalLinkage);
+    else
+        compiler->add_function_definition(name);
 
     llvm::Function* old_function = current_function();
     llvm::BasicBlock* old_block = builder().GetInsertBlock();
@@ -244,15 +246,7 @@ void FunctionDefinitionNode::construct_fields(const ClassType *class_type)
     {
         if (class_fields_args[i].name != "Super")
         {
-            bool found = false;
-            for (auto &field: class_type->fields()) {
-                if (field.name == class_fields_args[i].name) {
-                    found = true;
-                    break;
-                }
-            }
-
-            if (!found) {
+            if (class_type->get_field_index(class_fields_args[i].name) == -1) {
                 compiler->report_error("Can't initialize the field " + class_fields_args[i].name + " in the constructor " + name +
                              ", which is not a field of the class " + class_type->name);
             }
@@ -312,8 +306,8 @@ void FunctionDefinitionNode::construct_fields(const ClassType *class_type)
         if (field.name.empty()) continue;  // A placeholder
 
         bool found = false;
-        auto type = class_type->get_field(field.name).type;
-        auto ptr = class_type->get_field(self, field.name).get();
+        auto type = field.type;
+        auto ptr = class_type->get_field(self, i).get();
         std::vector<Value> args;
 
         // Check if there exists arguments passed to the constructor first
@@ -4,7 +4,7 @@
 namespace dua
 {
 
-int IfNode::_counter = 0;
+std::atomic<int> IfNode::_counter = 0;
 
 Value IfNode::eval()
 {
@@ -21,7 +21,6 @@ Value MallocNode::eval()
     // This must be a pointer type
     auto ptr_type = get_type()->as<PointerType>();
     auto element_type = ptr_type->get_element_type();
-    auto alloc_type = element_type->llvm_type();
 
     auto c = count->eval();
     auto as_i64 = c.cast_as(compiler->create_type<I64Type>(), false);
@@ -30,7 +29,8 @@ Value MallocNode::eval()
             + " can't be used as the count for the new operator. (While allocating " + element_type->to_string() + ")");
 
     // TODO is setting the size to 1 is the best solution for non-sized struct types?
-    size_t size = alloc_type->isSized() ? llvm::DataLayout(&module()).getTypeAllocSize(alloc_type) : 1;
+    auto size_info = typing_system().get_size_info(element_type);
+    size_t size = size_info.is_sized ? size_info.alloc_size : 1;
 
     llvm::Value* bytes = builder().getInt64(size);
     bytes = builder().CreateMul(as_i64.get(), bytes);
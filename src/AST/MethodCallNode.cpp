@@ -13,13 +13,7 @@ void MethodCallNode::process()
 
     auto class_type = get_instance_type();
 
-    is_callable_field = false;
-    for (auto& field : class_type->fields()) {
-        if (field.name == _current_name) {
-            is_callable_field = true;
-            break;
-        }
-    }
+    is_callable_field = class_type->get_field_index(_current_name) != -1;
 
     // Reserve a location for the self parameter
     if (!is_callable_field)
@@ -59,9 +53,19 @@ Value MethodCallNode::eval()
     for (size_t i = 0; i < args.size(); i++)
         arg_types[i] = args[i].type;
 
-    auto method = class_type->get_method(_current_name, instance_ptr, arg_types);
+    // An object that is held by value is always of its static type, so its methods can
+    //  be called without the vtable, unless _set_vtable is used anywhere in the program.
+    //  These are the variables, and the fields (ClassFieldNode is a VariableNode), that
+    //  are not references, whether their containing object is held by value or not.
+    auto variable = dynamic_cast<VariableNode*>(instance_node);
+    bool is_exact_type = variable != nullptr && !compiler->may_change_vtables()
+            && instance_node->get_type()->is<ClassType>() != nullptr;
+
+    auto method = class_type->get_method(_current_name, instance_ptr, arg_types, true, is_exact_type);
 
-    return name_resolver().call_function(method, std::move(args));
+    auto result = name_resolver().call_function(method, std::move(args));
+    class_type->add_callees_metadata(method, _current_name, arg_types);
+    return result;
 }
 
 const Type* MethodCallNode::get_type()
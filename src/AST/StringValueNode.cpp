@@ -5,7 +5,7 @@
 namespace dua
 {
 
-int StringValueNode::counter = 0;
+std::atomic<int> StringValueNode::counter = 0;
 
 Value StringValueNode::eval()
 {
@@ -3,7 +3,7 @@
 namespace dua
 {
 
-int WhileNode::_counter = 0;
+std::atomic<int> WhileNode::_counter = 0;
 
 NoneValue WhileNode::eval()
 {
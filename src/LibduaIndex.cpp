@@ -0,0 +1,228 @@
+#include <LibduaIndex.hpp>
+#include <cctype>
+
+namespace dua
+{
+
+struct ScanResult
+{
+    std::unordered_set<std::string> identifiers;
+    std::unordered_set<std::string> declared_names;
+
+    // String literals are turned into String objects when
+    //  libdua is included, thus, they depend on the String class
+    bool has_string_literals = false;
+};
+
+static bool is_identifier_start(char c) { return std::isalpha((unsigned char)c) || c == '_'; }
+static bool is_identifier_char (char c) { return std::isalnum((unsigned char)c) || c == '_'; }
+
+// A lightweight scan over the tokens of the code, that doesn't need to parse it.
+//  The declared names are collected from the top level declarations only, and
+//  are the name after the class keyword (forward declarations of classes don't
+//  count), or the identifier preceding the first (, <, =, or ; of the declaration,
+//  whichever comes first.
+static ScanResult scan(const std::string& code, bool collect_declared_names)
+{
+    ScanResult result;
+
+    size_t braces = 0, parentheses = 0;
+    bool is_named = false, expecting_class_name = false;
+    std::string previous_identifier, class_name;
+
+    // Operators are declared as "infix <<(...)" for example, and are
+    //  tied to the types of their operands rather than to a name
+    static const std::unordered_set<std::string> operator_keywords = { "infix", "prefix", "postfix" };
+
+    auto declare = [&](const std::string& name) {
+        if (operator_keywords.count(name)) {
+            is_named = true;
+            return;
+        }
+        if (collect_declared_names && braces == 0 && parentheses == 0 && !is_named && !name.empty()) {
+            result.declared_names.insert(name);
+            is_named = true;
+        }
+    };
+
+    size_t i = 0, n = code.size();
+    while (i < n)
+    {
+        char c = code[i];
+
+        if (std::isspace((unsigned char)c)) {
+            i++;
+            continue;
+        }
+
+        if (c == '/' && i + 1 < n && code[i + 1] == '/') {
+            while (i < n && code[i] != '\n') i++;
+            continue;
+        }
+
+        if (c == '/' && i + 1 < n && code[i + 1] == '*') {
+            auto end = code.find("*/", i + 2);
+            i = (end == std::string::npos) ? n : end + 2;
+            continue;
+        }
+
+        if (is_identifier_start(c)) {
+            size_t start = i;
+            while (i < n && is_identifier_char(code[i])) i++;
+            auto identifier = code.substr(start, i - start);
+            if (expecting_class_name) {
+                // Declared only if it has a body
+                expecting_class_name = false;
+                class_name = identifier;
+                is_named = true;
+            } else if (identifier == "class" && braces == 0 && parentheses == 0 && !is_named) {
+                expecting_class_name = true;
+            }
+            result.identifiers.insert(identifier);
+            previous_identifier = std::move(identifier);
+            continue;
+        }
+
+        if (c == '"' || c == '\'') {
+            if (c == '"') result.has_string_literals = true;
+            i++;
+            while (i < n && code[i] != c) {
+                if (code[i] == '\\') i++;
+                i++;
+            }
+            i++;
+            previous_identifier.clear();
+            continue;
+        }
+
+        switch (c)
+        {
+            case '(': declare(previous_identifier); parentheses++; break;
+            case ')': if (parentheses) parentheses--; break;
+            case '{':
+                if (!class_name.empty()) {
+                    is_named = false;
+                    declare(class_name);
+                    class_name.clear();
+                }
+                braces++;
+                break;
+            case '}':
+                if (braces) braces--;
+                if (braces == 0) is_named = false;
+                break;
+            case '<':
+            case '=': declare(previous_identifier); break;
+            case ';':
+                declare(previous_identifier);
+                if (braces == 0 && parentheses == 0) {
+                    is_named = false;
+                    class_name.clear();
+                }
+                break;
+        }
+
+        previous_identifier.clear();
+        i++;
+    }
+
+    return result;
+}
+
+template <typename T>
+static bool intersect(const std::unordered_set<T>& s1, const std::unordered_set<T>& s2)
+{
+    auto& smaller = s1.size() < s2.size() ? s1 : s2;
+    auto& larger  = s1.size() < s2.size() ? s2 : s1;
+    for (auto& element : smaller)
+        if (larger.count(element))
+            return true;
+    return false;
+}
+
+LibduaIndex::LibduaIndex()
+{
+    auto& declarations = get_libdua_declarations();
+    size_t n = declarations.size();
+
+    std::vector<ScanResult> scans;
+    scans.reserve(n);
+    for (auto& declaration : declarations)
+        scans.push_back(scan(declaration, true));
+
+    chunks.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        chunks[i].declared_names = std::move(scans[i].declared_names);
+        chunks[i].declares_string = chunks[i].declared_names.count("String");
+    }
+
+    std::vector<std::vector<size_t>> dependencies(n);
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+            if (i == j) continue;
+            bool string_dependency = scans[i].has_string_literals && chunks[j].declares_string;
+            if (string_dependency || intersect(scans[i].identifiers, chunks[j].declared_names))
+                dependencies[i].push_back(j);
+        }
+    }
+
+    // Compute the transitive closure, there are only a handful of chunks
+    for (size_t i = 0; i < n; i++) {
+        std::vector<bool> visited(n, false);
+        std::vector<size_t> stack = { i };
+        visited[i] = true;
+        while (!stack.empty()) {
+            auto current = stack.back();
+            stack.pop_back();
+            for (auto dependency : dependencies[current]) {
+                if (!visited[dependency]) {
+                    visited[dependency] = true;
+                    stack.push_back(dependency);
+                }
+            }
+        }
+        for (size_t j = 0; j < n; j++)
+            if (visited[j])
+                chunks[i].needed_chunks.push_back(j);
+    }
+}
+
+const LibduaIndex& LibduaIndex::get()
+{
+    // Thread-safe initialization, built once for all modules
+    static const LibduaIndex index;
+    return index;
+}
+
+std::string LibduaIndex::get_needed_declarations(const std::string& code) const
+{
+    auto scanned = scan(code, false);
+
+    std::vector<bool> needed(chunks.size(), false);
+    for (auto& chunk : chunks) {
+        bool string_dependency = scanned.has_string_literals && chunk.declares_string;
+        if (string_dependency || intersect(scanned.identifiers, chunk.declared_names))
+            for (auto i : chunk.needed_chunks)
+                needed[i] = true;
+    }
+
+    auto& declarations = get_libdua_declarations();
+
+    std::string result;
+    for (size_t i = 0; i < chunks.size(); i++)
+        if (needed[i])
+            result += declarations[i];
+
+    return result;
+}
+
+std::string LibduaIndex::get_chunk_declarations(size_t chunk) const
+{
+    auto& declarations = get_libdua_declarations();
+    std::string result;
+    for (auto i : chunks[chunk].needed_chunks)
+        result += declarations[i];
+    return result;
+}
+
+}
@@ -10,8 +10,10 @@
 #include "utils/CodeGeneration.hpp"
 #include "AST/BlockNode.hpp"
 #include "types/ArrayType.hpp"
-
-#include <fstream>
+#include <LibduaIndex.hpp>
+#include <resolution/InstantiationRegistry.hpp>
+#include <resolution/ProgramInfo.hpp>
+#include <utils/TimeReport.hpp>
 
 #include <llvm/Support/Host.h>
 #include <llvm/Transforms/Utils/ModuleUtils.h>
@@ -20,9 +22,8 @@
 namespace dua
 {
 
-std::vector<std::string>& get_libdua_declarations();
-
-ModuleCompiler::ModuleCompiler(std::string module_name, std::string code, bool include_libdua) :
+ModuleCompiler::ModuleCompiler(std::string module_name, std::string code, bool include_libdua, InstantiationRegistry* instantiation_registry, bool whole_program,
+                               const ProgramInfo* program) :
     context(),
     module(module_name, context),
     builder(context),
@@ -32,7 +33,10 @@ ModuleCompiler::ModuleCompiler(std::string module_name, std::string code, bool i
     typing_system(this),
     include_libdua(include_libdua),
     temp_expressions(this),
-    code(std::move(code))
+    code(std::move(code)),
+    instantiation_registry(instantiation_registry),
+    program(program),
+    whole_program(whole_program)
 {
     module.setTargetTriple(llvm::sys::getDefaultTargetTriple());
 
@@ -48,36 +52,47 @@ ModuleCompiler::ModuleCompiler(std::string module_name, std::string code, bool i
 
     create_dua_cleanup_function();
 
-    if (include_libdua) {
-        for (auto &declarations: get_libdua_declarations())
-            this->code += declarations;
-    }
+    if (include_libdua)
+        this->code += LibduaIndex::get().get_needed_declarations(this->code);
 
     // Parse
-    TranslationUnitNode* ast = parser.parse(this->code);
+    TranslationUnitNode* ast;
+    {
+        PhaseTimer timer("Parsing");
+        ast = parser.parse(this->code);
+    }
 
     // Generate LLVM IR
-    ast->eval();
-
-    destruct_global_scope();
+    {
+        PhaseTimer timer("Code generation");
 
-    // It's important that this function gets called
-    //  before finalizing the .dua.init function,
-    //  because the .dua.cleanup function is registered
-    //  in the .dua.init function
-    complete_dua_cleanup_function();
+        ast->eval();
 
-    complete_dua_init_function();
+        destruct_global_scope();
 
-    llvm::raw_string_ostream stream(result);
-    module.print(stream, nullptr);
-    result = stream.str();
+        // It's important that this function gets called
+        //  before finalizing the .dua.init function,
+        //  because the .dua.cleanup function is registered
+        //  in the .dua.init function
+        complete_dua_cleanup_function();
 
-    std::ofstream outfile ("E:/test.txt");
+        complete_dua_init_function();
+    }
 
-    outfile << result << std::endl;
+    add_to_counter("AST nodes", nodes_count);
+    add_to_counter("Types interned", typing_system.get_interned_types_count());
+    add_to_counter("Arena bytes", arena.get_allocated_size());
+}
 
-    outfile.close();
+const std::string& ModuleCompiler::get_result()
+{
+    if (result.empty()) {
+        PhaseTimer timer("Printing");
+        llvm::raw_string_ostream stream(result);
+        module.print(stream, nullptr);
+        stream.flush();
+    }
+    return result;
 }
 
 void ModuleCompiler::create_dua_init_function()
@@ -117,10 +132,42 @@ void ModuleCompiler::complete_dua_init_function()
     }
 }
 
-ModuleCompiler::~ModuleCompiler()
+void ModuleCompiler::add_function_definition(const std::string &name)
+{
+    if (instantiation_registry == nullptr || !InstantiationRegistry::is_template_instance(name))
+        return;
+    instantiation_registry->add_definition(name, module_name);
+    template_instances.push_back(name);
+}
+
+void ModuleCompiler::declare_instances_owned_elsewhere()
 {
-    for (auto node : nodes)
-        delete node;
+    for (auto& name : template_instances) {
+        if (instantiation_registry->is_owner(name, module_name))
+            continue;
+        // Linked against the owner's definition
+        module.getFunction(name)->deleteBody();
+        add_to_counter("Template instances defined by other modules");
+    }
+    template_instances.clear();
+}
+
+bool ModuleCompiler::may_change_vtables() const
+{
+    return program == nullptr || program->uses_set_vtable || uses_set_vtable;
+}
+
+bool ModuleCompiler::knows_all_subclasses() const
+{
+    // The instances of a templated class that has a parent can become subclasses
+    //  of the parent at any point of the code generation, possibly after the calls
+    //  on the parent are generated, so nothing is assumed in their presence.
+    return program != nullptr && program->is_single_module && !name_resolver.has_templated_subclasses();
+}
+
+bool ModuleCompiler::is_leaf_class(const ClassType* cls) const
+{
+    return knows_all_subclasses() && !name_resolver.has_subclasses(cls->name);
 }
 
 void ModuleCompiler::push_scope() {
@@ -422,9 +469,11 @@ void ModuleCompiler::destruct_global_scope()
     // Destruct global variables in the .dua.cleanup function
     builder.SetInsertPoint(&get_dua_cleanup_function()->getEntryBlock());
 
-    auto global_scope = name_resolver.symbol_table.scopes[0].map;
-    for (auto& [name, value] : global_scope)
+    auto global_scope = name_resolver.symbol_table.scopes[0];
+    for (size_t i = 0; i < global_scope.map.size(); i++)
     {
+        if (global_scope.is_erased(i)) continue;
+        auto value = global_scope.map[i].value;
         auto type = value.type->get_concrete_type();
         // Type::as discards references.
         auto as_class = dynamic_cast<const ClassType*>(type);
@@ -465,7 +514,10 @@ void ModuleCompiler::push_temp_expr_scope() {
 
 void ModuleCompiler::destruct_temp_expr_scope()
 {
-    for (auto& [id, value] : temp_expressions.scopes.back().map) {
+    auto& scope = temp_expressions.scopes.back();
+    for (size_t i = 0; i < scope.map.size(); i++) {
+        if (scope.is_erased(i)) continue;
+        auto& value = scope.map[i].value;
         // Creating a value with the pointer. This is what destruct method accepts
         auto ptr = create_value(value.memory_location, value.type);
         name_resolver.destruct(ptr);
@@ -558,8 +610,6 @@ std::vector<std::string> libdua_declarations {
 //  because the declaration alone doesn't instantiate a concrete class.
 R"(
 
-nomangle int printf(str message, ...);
-
 class Vector<T>
 {
     typealias size_t = long;
@@ -617,15 +667,38 @@ class Vector<T>
         untrack(t);
     }
 
+    // Unlike push, which copies the element into the buffer, the emplace
+    //  methods construct the element in its place at the end of the buffer
+    T& emplace()
+    {
+        expand_if_needed();
+        T* elements = data();
+        construct(elements[_size]);
+        return elements[_size++];
+    }
+
+    T& emplace<A>(A a)
+    {
+        expand_if_needed();
+        T* elements = data();
+        construct(elements[_size])(a);
+        return elements[_size++];
+    }
+
+    T& emplace<A, B>(A a, B b)
+    {
+        expand_if_needed();
+        T* elements = data();
+        construct(elements[_size])(a, b);
+        return elements[_size++];
+    }
+
     T pop()
     {
         if (_size == 0)
             panic("Can't pop an empty vector");
 
-        // If the buffer refers to a constant memory,
-        //  a new buffer must be allocated to modify it
-        if (_is_const_initialized)
-            alloc_new_buffer(_capacity);
+        make_writable();
 
         return teleport(buffer[--_size]);
     }
@@ -644,16 +717,42 @@ class Vector<T>
         //  in case of temporary string literals, which are just a temporary
         //  objects that won't be modified. Instead of copying them, wrap
         //  them with a String object without copying.
+        make_writable();
+
+        return buffer[i];
+    }
+
+    // The address of the first element
+    T* data() { return buffer; }
+
+    // Neither checks the bounds nor copies a constant buffer. Loops that
+    //  call make_writable once before them can use it instead of the []
+    //  operator, so that the body has no branches and can be vectorized.
+    T& get_unchecked(size_t i) { return buffer[i]; }
+
+    // If the buffer refers to a constant memory,
+    //  a new buffer must be allocated to modify it
+    void make_writable()
+    {
         if (_is_const_initialized)
             alloc_new_buffer(_capacity);
+    }
 
-        return buffer[i];
+    // The capacity is multiplied when more space is needed, instead of growing
+    //  to the required size only, so that a sequence of insertions takes an
+    //  amortized constant time per element. This applies to resizing as well.
+    size_t grown_capacity(size_t required)
+    {
+        size_t grown = _capacity * 2;
+        if (grown < 2)
+            grown = 2;
+        return grown < required ? required : grown;
     }
 
     void expand_if_needed()
     {
         if (_size == _capacity || _is_const_initialized)
-            alloc_new_buffer(_size * 2);
+            alloc_new_buffer(grown_capacity(_size + 1));
     }
 
     void trim_to_fit()
@@ -671,10 +770,10 @@ class Vector<T>
 
         size_t n = _size < new_capacity ? _size : new_capacity;
 
-        for (size_t i = 0; i < n; i++) {
-            // To avoid calling the destructor on temp[i]
-            mirror_memory<T>(temp[i], buffer[i]);
-        }
+        // The elements are moved all at once, without calling
+        //  their destructors, just like mirror_memory does
+        if (n > 0)
+            memcpy(((int*))temp, ((int*))buffer, n * sizeof(T));
 
         free_buffer();
         buffer = temp;
@@ -689,8 +788,9 @@ class Vector<T>
         if (new_size <= 0)
             panic("Cannot resize to a non-positive size");
 
-        if (new_size > _capacity)
-            alloc_new_buffer(new_size);
+        // The constant memory can't be written to
+        if (new_size > _capacity || _is_const_initialized)
+            alloc_new_buffer(new_size > _capacity ? grown_capacity(new_size) : _capacity);
 
         for (size_t i = _size; i < new_size; i++)
             construct(buffer[i]);
@@ -752,15 +852,19 @@ class Vector<T>
     //  is not needed if the class is going to be used just
     //  for storing elements, regardless of their order.
     void sort<Comparator>() {
-        sort<T, Comparator>(buffer, size());
+        sort<T, Comparator>(data(), size());
     }
 
     void shuffle() {
-        shuffle<T>(buffer, size());
+        shuffle<T>(data(), size());
+    }
+
+    void shuffle(Random& random) {
+        shuffle<T>(data(), size(), random);
     }
 
     void reverse() {
-        reverse<T>(buffer, size());
+        reverse<T>(data(), size());
     }
 
     bool is_empty() { return size() == 0; }
@@ -789,6 +893,8 @@ class Vector<T>
         if (index >= size())
             panic("Can't remove at an index bigger than the size");
 
+        make_writable();
+
         T removed = teleport(buffer[index]);
 
         for (size_t i = index; i < _size - 1; i++) {
@@ -821,8 +927,6 @@ class Vector<T>
     }
 }
 
-void panic(str message);
-
 )"
 ,
 R"(
@@ -831,6 +935,8 @@ class String : Vector<i8>
 {
     typealias size_t = long;
 
+    bool _is_small = false;
+
     constructor();
     constructor(str string);
     constructor(size_t n, byte c);
@@ -840,8 +946,19 @@ class String : Vector<i8>
     =constructor(String& string);
     =constructor(str string);
 
+    Declaration str data();
+    Declaration byte& get_unchecked(size_t i);
+    byte& postfix [](size_t i);
+    Declaration size_t _buffer_capacity();
+    Declaration size_t grown_capacity(size_t required);
+    Declaration void expand_if_needed();
+    Declaration void alloc_new_buffer(size_t new_capacity);
+    Declaration void reserve(size_t amount);
+    Declaration void free_buffer();
+
     Declaration void push(byte c);
     Declaration byte pop();
+    Declaration byte remove(size_t index);
     Declaration String substring(size_t from, size_t upto);
     Declaration void resize(size_t new_size);
 
@@ -850,6 +967,7 @@ class String : Vector<i8>
 
     Declaration str c_str();
 
+    String& infix =(String& other);
     String& infix =(str string);
     String infix +(String& other);
     String infix +(str other);
@@ -938,19 +1056,276 @@ Declaration void set_random_seed();
 
 Declaration i16 random_int();
 
+Declaration i64 random_seed();
+
+class Random
+{
+    i64 s0;
+    i64 s1;
+    i64 s2;
+    i64 s3;
+
+    constructor();
+    constructor(i64 value);
+
+    Declaration void seed(i64 value);
+    Declaration i64 split_mix(i64 z);
+    Declaration i64 next_long();
+    Declaration i64 next(i64 n);
+    Declaration double uniform();
+
+    destructor;
+}
+
 )"
 ,
 R"(
 
-int c_comparator_converter<T, Comparator>(T* a, T* b)
+// Sorts with an introsort: a quicksort with a median-of-three pivot that
+//  switches to a heapsort when the recursion gets too deep, and leaves the
+//  short ranges to an insertion sort. The comparator is a template argument
+//  that is held by value, so its compare method is called directly and
+//  can be inlined, instead of being called through a function pointer.
+void sort<T, Comparator>(T* base, long n)
 {
+    // Twice the logarithm of n, after which quicksort is
+    //  considered to be degenerating into its quadratic worst case
+    long depth_limit = 0;
+    for (long i = n; i > 1; i /= 2)
+        depth_limit += 2;
+
+    introsort<T, Comparator>(base, n, depth_limit);
+}
+
+// Unlike sort, the elements that are equal keep their order
+void stable_sort<T, Comparator>(T* base, long n)
+{
+    if (n <= 16) {
+        insertion_sort<T, Comparator>(base, n);
+        return;
+    }
+
+    // Merging needs a buffer as big as the left half of the array
+    T* buffer = _RAW_ new[n / 2] T;
+    merge_sort<T, Comparator>(base, n, buffer);
+    _RAW_ delete[] buffer;
+}
+
+// Puts the smallest k elements, sorted, at the beginning of the
+//  array. The order of the rest of the elements is unspecified.
+void partial_sort<T, Comparator>(T* base, long n, long k)
+{
+    if (k <= 0)
+        return;
+    if (k > n)
+        k = n;
+
     Comparator cmp;
-    return cmp.compare(*a, *b);
+
+    // The first k elements are kept as a heap, whose top
+    //  is the biggest of the smallest elements found so far
+    make_heap<T, Comparator>(base, k);
+    for (long i = k; i < n; i++) {
+        if (cmp.compare(base[i], base[0]) < 0) {
+            swap<T>(base[i], base[0]);
+            sift_down<T, Comparator>(base, 0, k);
+        }
+    }
+
+    sort_heap<T, Comparator>(base, k);
 }
 
-void sort<T, Comparator>(T* base, long n)
+// Puts the element at the position k where it would be if the array was
+//  sorted, where the elements before it are not bigger than it, and the
+//  elements after it are not smaller than it.
+void nth_element<T, Comparator>(T* base, long n, long k)
 {
-    qsort(((int*))base, n, sizeof(T), ((int(int*, int*)*))c_comparator_converter<T, Comparator>);
+    if (k < 0 || k >= n)
+        return;
+
+    // The same limit as that of sort
+    long depth_limit = 0;
+    for (long i = n; i > 1; i /= 2)
+        depth_limit += 2;
+
+    while (n > 16)
+    {
+        if (depth_limit == 0) {
+            heap_sort<T, Comparator>(base, n);
+            return;
+        }
+        depth_limit--;
+
+        long p = partition<T, Comparator>(base, n);
+        if (p == k)
+            return;
+
+        if (k < p) {
+            n = p;
+        } else {
+            base = &base[p + 1];
+            n -= p + 1;
+            k -= p + 1;
+        }
+    }
+
+    insertion_sort<T, Comparator>(base, n);
+}
+
+void introsort<T, Comparator>(T* base, long n, long depth_limit)
+{
+    // The ranges of up to 16 elements are left to the insertion sort
+    while (n > 16)
+    {
+        if (depth_limit == 0) {
+            heap_sort<T, Comparator>(base, n);
+            return;
+        }
+        depth_limit--;
+
+        long p = partition<T, Comparator>(base, n);
+
+        // Recursing into the smaller side, and looping over the
+        //  bigger one, bounds the stack depth by log(n)
+        if (p < n - p - 1) {
+            introsort<T, Comparator>(base, p, depth_limit);
+            base = &base[p + 1];
+            n -= p + 1;
+        } else {
+            introsort<T, Comparator>(&base[p + 1], n - p - 1, depth_limit);
+            n = p;
+        }
+    }
+
+    insertion_sort<T, Comparator>(base, n);
+}
+
+// Returns the final position of the pivot, where the elements before it are
+//  not bigger than it, and the elements after it are not smaller than it.
+//  The array must have at least 3 elements.
+long partition<T, Comparator>(T* base, long n)
+{
+    Comparator cmp;
+
+    long mid = n / 2;
+    long last = n - 1;
+
+    // Ordering the first, middle and last elements, and taking
+    //  the median of them as the pivot, which is put at the beginning
+    if (cmp.compare(base[mid], base[0]) < 0)
+        swap<T>(base[mid], base[0]);
+    if (cmp.compare(base[last], base[mid]) < 0) {
+        swap<T>(base[last], base[mid]);
+        if (cmp.compare(base[mid], base[0]) < 0)
+            swap<T>(base[mid], base[0]);
+    }
+    swap<T>(base[0], base[mid]);
+
+    // The scans are bounded even though the pivot and the last element stop
+    //  them, so that an inconsistent comparator can't go out of the array
+    long i = 0;
+    long j = n;
+    while (true)
+    {
+        i++;
+        while (i < last && cmp.compare(base[i], base[0]) < 0)
+            i++;
+        j--;
+        while (j > 0 && cmp.compare(base[0], base[j]) < 0)
+            j--;
+
+        if (i >= j)
+            break;
+
+        swap<T>(base[i], base[j]);
+    }
+
+    swap<T>(base[0], base[j]);
+    return j;
+}
+
+void insertion_sort<T, Comparator>(T* base, long n)
+{
+    Comparator cmp;
+    for (long i = 1; i < n; i++)
+        for (long j = i; j > 0 && cmp.compare(base[j], base[j - 1]) < 0; j--)
+            swap<T>(base[j], base[j - 1]);
+}
+
+void merge_sort<T, Comparator>(T* base, long n, T* buffer)
+{
+    if (n <= 16) {
+        insertion_sort<T, Comparator>(base, n);
+        return;
+    }
+
+    long mid = n / 2;
+    merge_sort<T, Comparator>(base, mid, buffer);
+    merge_sort<T, Comparator>(&base[mid], n - mid, buffer);
+
+    Comparator cmp;
+
+    // The halves are already in order
+    if (cmp.compare(base[mid], base[mid - 1]) >= 0)
+        return;
+
+    // The elements are moved by copying their memory, just like
+    //  mirror_memory does, so they're neither copied nor destructed
+    memcpy(((int*))buffer, ((int*))base, mid * sizeof(T));
+
+    long i = 0;
+    long j = mid;
+    long k = 0;
+    while (i < mid && j < n)
+    {
+        // Taking from the left half on ties keeps the sort stable
+        if (cmp.compare(base[j], buffer[i]) < 0)
+            mirror_memory<T>(base[k++], base[j++]);
+        else
+            mirror_memory<T>(base[k++], buffer[i++]);
+    }
+
+    // What's left of the right half is already in place
+    if (i < mid)
+        memcpy(((int*))&base[k], ((int*))&buffer[i], (mid - i) * sizeof(T));
+}
+
+void heap_sort<T, Comparator>(T* base, long n)
+{
+    make_heap<T, Comparator>(base, n);
+    sort_heap<T, Comparator>(base, n);
+}
+
+// The biggest element is at the top of the heap
+void make_heap<T, Comparator>(T* base, long n)
+{
+    for (long i = n / 2 - 1; i >= 0; i--)
+        sift_down<T, Comparator>(base, i, n);
+}
+
+void sort_heap<T, Comparator>(T* base, long n)
+{
+    for (long i = n - 1; i > 0; i--) {
+        swap<T>(base[0], base[i]);
+        sift_down<T, Comparator>(base, 0, i);
+    }
+}
+
+void sift_down<T, Comparator>(T* base, long root, long n)
+{
+    Comparator cmp;
+    while (true)
+    {
+        long child = 2 * root + 1;
+        if (child >= n)
+            return;
+        if (child + 1 < n && cmp.compare(base[child], base[child + 1]) < 0)
+            child++;
+        if (cmp.compare(base[root], base[child]) >= 0)
+            return;
+        swap<T>(base[root], base[child]);
+        root = child;
+    }
 }
 
 class ascending_comparator<T>
@@ -989,17 +1364,20 @@ void sort_descending<T>(T* base, long n)
     sort<T, descending_comparator<T>>(base, n);
 }
 
-class random_comparator<T>
+// The Fisher-Yates shuffle, where every permutation is equally likely
+void shuffle<T>(T* base, long n, Random& random)
 {
-    int compare(T& a, T& b)
-    {
-        return (random_int() % 2) ? 1 : -1;
+    for (long i = n - 1; i > 0; i--) {
+        long j = random.next(i + 1);
+        if (j != i)
+            swap<T>(base[i], base[j]);
     }
 }
 
 void shuffle<T>(T* base, long n)
 {
-    sort<T, random_comparator<T>>(base, n);
+    Random random(random_seed());
+    shuffle<T>(base, n, random);
 }
 
 void reverse<T>(T* base, long n)
@@ -1027,10 +1405,11 @@ void swap<T>(T& a, T& b)
     T temp = teleport(a);
     mirror_memory<T>(a, b);
     mirror_memory<T>(b, temp);
+    // The object is in b now, and must not be destructed
+    untrack(temp);
 }
 
 nomangle void memcpy(int* to, int* from, long bytes);
-nomangle void qsort(int* base, long n, long size, int(int*, int*)* comparator);
 
 )"
 ,
@@ -1134,6 +1513,8 @@ class MaxPriorityQueue<T> : PriorityQueue<T, descending_comparator<T>> { }
 ,
 R"(
 
+nomangle int printf(str message, ...);
+
 nomangle void exit(int exit_code);
 
 nomangle void getenv(str name);
@@ -1,8 +1,9 @@
 #include <Preprocessor.hpp>
 #include <utils/ErrorReporting.hpp>
+#include <utils/TimeReport.hpp>
 #include <utils/TextManipulation.hpp>
 #include <string>
-#include <sstream>
+#include <cctype>
 #include <filesystem>
 
 
@@ -13,75 +14,172 @@ inline std::string get_full_path(const std::string& path) {
     return std::filesystem::absolute(std::filesystem::weakly_canonical(path)).string();
 }
 
-inline std::string get_parent_path(const std::string& path) {
-    auto p = absolute(std::filesystem::path(path));
-    auto parent = p.parent_path();
-    auto result = parent.string();
-    return result;
+static std::string resolve_import(const std::filesystem::path& directory, std::string_view import_path)
+{
+    std::filesystem::path path(import_path);
+    if (path.is_relative())
+        path = directory / path;
+    return std::filesystem::weakly_canonical(path).string();
 }
 
-std::string Preprocessor::process(const std::string &filename, const std::string &content)
+// The files with \r\n line endings are copied, with the line endings normalized
+static std::shared_ptr<const llvm::MemoryBuffer> with_normalized_line_endings(std::unique_ptr<llvm::MemoryBuffer> buffer)
 {
-    imported.clear();
-    return _process(filename, content);
+    if (buffer->getBuffer().find("\r\n") == llvm::StringRef::npos)
+        return buffer;
+    auto text = normalize_line_endings(std::string_view(buffer->getBufferStart(), buffer->getBufferSize()));
+    return llvm::MemoryBuffer::getMemBufferCopy(text, buffer->getBufferIdentifier());
+}
+
+static std::shared_ptr<const llvm::MemoryBuffer> map_file(const std::string& path)
+{
+    // Small files are read, and the rest are memory mapped
+    auto buffer = llvm::MemoryBuffer::getFile(path, false, false);
+    if (!buffer)
+        report_error("Couldn't read the contents of the file at " + path);
+    return with_normalized_line_endings(std::move(*buffer));
+}
+
+size_t SourceBuffer::add_file(std::shared_ptr<const llvm::MemoryBuffer> file)
+{
+    files.push_back(std::move(file));
+    return files.size() - 1;
+}
+
+void SourceBuffer::append(size_t file, size_t offset, size_t length)
+{
+    if (length == 0)
+        return;
+    slices.push_back({ file, offset, length });
+    total_size += length;
+}
+
+std::string_view SourceBuffer::get_file_text(size_t file) const
+{
+    auto& buffer = files[file];
+    return { buffer->getBufferStart(), buffer->getBufferSize() };
+}
+
+std::string_view SourceBuffer::get_text(const Slice& slice) const {
+    return get_file_text(slice.file).substr(slice.offset, slice.length);
 }
 
-std::string Preprocessor::_process(const std::string &filename, const std::string &content)
+std::string SourceBuffer::str() const
 {
-    std::string keyword = "import";
     std::string result;
+    result.reserve(total_size);
+    for (auto& slice : slices)
+        result += get_text(slice);
+    return result;
+}
 
-    // This is to avoid importing recursively forever
-    auto it = imported.find(filename);
-    if (it != imported.end()) {
-        return "";
+const ImportGraph::Node& ImportGraph::get_file(const std::string &path)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (auto it = nodes.find(path); it != nodes.end()) {
+            add_to_counter("Import cache hits");
+            return *it->second;
+        }
     }
 
-    imported.insert(filename);
+    // Read without holding the lock. If another preprocessor
+    //  reads the same file meanwhile, only one of them is kept.
+    auto node = std::make_unique<Node>(scan(map_file(path), path));
+    add_to_counter("Imported files read");
+
+    std::lock_guard<std::mutex> lock(mutex);
+    return *nodes.emplace(path, std::move(node)).first->second;
+}
+
+ImportGraph::Node ImportGraph::scan(std::shared_ptr<const llvm::MemoryBuffer> content, const std::string &path)
+{
+    std::string_view keyword = "import";
 
-    auto old_path = std::filesystem::current_path();
-    std::filesystem::current_path(get_parent_path(filename));
+    Node result;
+    std::string_view text(content->getBufferStart(), content->getBufferSize());
+    auto directory = std::filesystem::path(path).parent_path();
 
     size_t i = 0;
     while (true)
     {
         size_t keyword_start = i;
-        while (keyword_start < content.size() &&
-            (isspace(content[keyword_start]) || content[keyword_start] == '\n')) keyword_start++;
+        while (keyword_start < text.size() &&
+            (isspace(text[keyword_start]) || text[keyword_start] == '\n')) keyword_start++;
 
-        if (keyword_start + keyword.size() >= content.size() || !starts_with(content, keyword, keyword_start))
+        if (keyword_start + keyword.size() >= text.size() || text.compare(keyword_start, keyword.size(), keyword) != 0)
             break;
 
         size_t keyword_end = keyword_start + keyword.size();
-        while (keyword_end < content.size() && std::isspace(content[keyword_end])) keyword_end++;
+        while (keyword_end < text.size() && std::isspace(text[keyword_end])) keyword_end++;
 
-        if (content.size() - keyword_end <= 2)
+        if (text.size() - keyword_end <= 2)
             report_error("Preprocessor: Can't have empty imports");
-        if (content[keyword_end] != '"')
+        if (text[keyword_end] != '"')
             report_error("Preprocessor: Imports must be specified between two \"\"");
 
         auto path_start = keyword_end + 1;
         size_t path_end = path_start + 1;
-        while (path_end < content.size() && !(content[path_end] == '"' && content[path_end - 1] != '\\')) path_end++;
+        while (path_end < text.size() && !(text[path_end] == '"' && text[path_end - 1] != '\\')) path_end++;
 
-        if (path_end == content.size())
+        if (path_end == text.size())
             report_error("Preprocessor: Imports must be specified between two \"\"");
 
-        auto import_path = content.substr(path_start, path_end - path_start);
-        import_path = get_full_path(import_path);
-
-        result += content.substr(i, keyword_start - i);
-
-        result += _process(import_path, read_file(import_path));
+        result.segments.push_back({ "", i, keyword_start - i });
+        result.segments.push_back({ resolve_import(directory, text.substr(path_start, path_end - path_start)) });
 
         i = path_end + 1;
     }
 
-    result += content.substr(i, content.size() - i);
+    result.segments.push_back({ "", i, text.size() - i });
+    result.content = std::move(content);
 
-    std::filesystem::current_path(old_path);
+    return result;
+}
 
+SourceBuffer Preprocessor::process_file(const std::string &filename)
+{
+    imported.clear();
+    auto path = get_full_path(filename);
+    SourceBuffer result;
+    _process(result, path, graph->get_file(path), false);
     return result;
 }
 
-}
\ No newline at end of file
+std::string Preprocessor::process(const std::string &filename, const std::string &content)
+{
+    imported.clear();
+    auto path = get_full_path(filename);
+    // The content outlives the buffer, and doesn't need to be copied
+    auto node = ImportGraph::scan(with_normalized_line_endings(llvm::MemoryBuffer::getMemBuffer(content, filename, false)), path);
+    SourceBuffer result;
+    _process(result, path, node, false);
+    return result.str();
+}
+
+void Preprocessor::_process(SourceBuffer& result, const std::string &path, const ImportGraph::Node& node, bool is_import)
+{
+    // This is to avoid importing recursively forever
+    if (!imported.insert(path).second)
+        return;
+
+    auto file = result.add_file(node.content);
+
+    for (auto& segment : node.segments) {
+        if (segment.import_path.empty())
+            result.append(file, segment.offset, segment.length);
+        else if (imported.find(segment.import_path) == imported.end())
+            _process(result, segment.import_path, graph->get_file(segment.import_path), true);
+    }
+
+    // The text after an import starts on a new line, so that the last
+    //  line of the imported file (e.g. a comment) doesn't extend to it
+    auto text = result.get_file_text(file);
+    if (is_import && !text.empty() && text.back() != '\n') {
+        static const char new_line[] = "\n";
+        auto line = result.add_file(llvm::MemoryBuffer::getMemBuffer(llvm::StringRef(new_line, 1), "", false));
+        result.append(line, 0, 1);
+    }
+}
+
+}
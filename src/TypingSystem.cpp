@@ -11,12 +11,13 @@
 namespace dua
 {
 
-TypingSystem::TypingSystem(ModuleCompiler *compiler) : compiler(compiler), identifier_types(compiler) {}
+std::atomic<size_t> TypingSystem::intern_tables_count = 0;
+
+TypingSystem::TypingSystem(ModuleCompiler *compiler) : compiler(compiler), arena(compiler->arena), identifier_types(compiler) {}
 
 static Value _cast_value(const Value& value, const Type* type, bool panic_on_failure, ModuleCompiler* compiler)
 {
     auto& builder = *compiler->get_builder();
-    auto& module = *compiler->get_module();
 
     llvm::Type* source_type = value.get()->getType();
     llvm::Type* target_type = type->llvm_type();
@@ -78,7 +79,7 @@ static Value _cast_value(const Value& value, const Type* type, bool panic_on_fai
         // else, the below code will handle it
     }
 
-    llvm::DataLayout dl(&module);
+    auto& dl = compiler->get_typing_system().data_layout();
     unsigned int source_width = dl.getTypeSizeInBits(source_type);
     unsigned int target_width = dl.getTypeSizeInBits(target_type);
 
@@ -219,7 +220,7 @@ const Type* TypingSystem::get_winning_type(const Type* lhs, const Type* rhs, boo
     auto l = lhs->get_contained_type()->llvm_type();
     auto r = rhs->get_contained_type()->llvm_type();
 
-    llvm::DataLayout dl(&module());
+    auto& dl = data_layout();
     unsigned int l_width = dl.getTypeAllocSize(l);
     unsigned int r_width = dl.getTypeAllocSize(r);
 
@@ -301,6 +302,8 @@ int TypingSystem::similarity_score(const Type *t1, const Type *t2) const
 
     // This is needed for the case of two equivalent types with two different class types,
     //  such as an IdentifierType and a ClassType, both referring to the same type.
+    //  Since the types are interned, the comparison stops at the first pair of
+    //  identical element types, instead of walking the whole type.
     if (*t1 == *t2 || *t1 == *t2->get_contained_type()) return 0;
 
     // For types that must be the same, the above check is enough,
@@ -420,6 +423,31 @@ bool TypingSystem::is_castable(const Type* t1, const Type* t2) const {
     return similarity_score(t1, t2) != -1;
 }
 
+const llvm::DataLayout &TypingSystem::data_layout() const {
+    return compiler->module.getDataLayout();
+}
+
+TypeSizeInfo TypingSystem::get_size_info(const Type *type) const
+{
+    type = type->get_concrete_type();
+    if (auto it = size_infos.find(type); it != size_infos.end())
+        return it->second;
+
+    auto llvm_type = type->llvm_type();
+    if (!llvm_type->isSized())
+        return { false, 0, 0, 1 };
+
+    auto& layout = data_layout();
+    TypeSizeInfo info {
+        true,
+        layout.getTypeSizeInBits(llvm_type),
+        layout.getTypeAllocSize(llvm_type),
+        layout.getABITypeAlign(llvm_type).value()
+    };
+    size_infos.emplace(type, info);
+    return info;
+}
+
 llvm::IRBuilder<> &TypingSystem::builder() const {
     return compiler->builder;
 }
@@ -428,12 +456,6 @@ llvm::Module &TypingSystem::module() const {
     return compiler->module;
 }
 
-TypingSystem::~TypingSystem()
-{
-    for (const auto& type : type_cache)
-        delete type.second;
-}
-
 void TypingSystem::push_scope() {
     identifier_types.push_scope();
 }
@@ -1238,6 +1238,7 @@ void ParserAssistant::create_untrack() {
 }
 
 void ParserAssistant::create_set_vtable() {
+    compiler->uses_set_vtable = true;
     push_node<SetVtableNode>(pop_node(), pop_type());
     inc_statements();
 }
@@ -44,6 +44,50 @@ VTable* ClassResolver::get_vtable_instance(const std::string &class_name)
     return it->second;
 }
 
+bool ClassResolver::has_subclasses(const std::string& class_name) const
+{
+    for (auto& [child, parent] : parent_classes)
+        if (parent->name == class_name)
+            return true;
+    return false;
+}
+
+std::vector<llvm::Function*> ClassResolver::get_method_implementations(const std::string& class_name, const std::string& method_name)
+{
+    auto vtable = vtables.find(class_name);
+    if (vtable == vtables.end())
+        return {};
+    auto index = vtable->second->method_indices.find(method_name);
+    if (index == vtable->second->method_indices.end())
+        return {};
+
+    // The vtable of a subclass starts with the vtable of its parent,
+    //  so the method is at the same index in all of the vtables
+    std::vector<llvm::Function*> implementations;
+    std::vector<std::string> classes = { class_name };
+    while (!classes.empty())
+    {
+        auto name = std::move(classes.back());
+        classes.pop_back();
+
+        auto it = vtables.find(name);
+        if (it == vtables.end() || !it->second->instance->hasInitializer())
+            return {};
+        auto element = it->second->instance->getInitializer()->getAggregateElement(index->second);
+        auto function = element ? llvm::dyn_cast<llvm::Function>(element->stripPointerCasts()) : nullptr;
+        if (function == nullptr)
+            return {};
+        if (std::find(implementations.begin(), implementations.end(), function) == implementations.end())
+            implementations.push_back(function);
+
+        for (auto& [child, parent] : parent_classes)
+            if (parent->name == name)
+                classes.push_back(child);
+    }
+
+    return implementations;
+}
+
 ClassResolver::~ClassResolver() {
     for (const auto& vtable : vtables)
         delete vtable.second;
@@ -98,11 +142,25 @@ void ClassResolver::create_vtable(const std::string &class_name)
     compiler->get_module()->getOrInsertGlobal(instance_name, vtable_type);
     auto instance_ptr = compiler->get_module()->getGlobalVariable(instance_name);
     instance_ptr->setInitializer(value);
+    // Never written to, which lets the loads of the methods be folded
+    //  when the vtable is known, and is required for the devirtualization
+    instance_ptr->setConstant(true);
 
     auto comdat = compiler->get_module()->getOrInsertComdat(instance_name);
     comdat->setSelectionKind(llvm::Comdat::Any);
     instance_ptr->setComdat(comdat);
 
+    if (compiler->whole_program) {
+        // The vtable of a class starts with the vtable of its parent, thus, it's compatible
+        //  with the virtual calls through each of its ancestors. No code outside of the
+        //  program can subclass the classes, which is what the linkage unit visibility means.
+        auto& context = *compiler->get_context();
+        instance_ptr->addTypeMetadata(0, llvm::MDString::get(context, class_name));
+        for (auto it = parent_classes.find(class_name); it != parent_classes.end(); it = parent_classes.find(it->second->name))
+            instance_ptr->addTypeMetadata(0, llvm::MDString::get(context, it->second->name));
+        instance_ptr->setVCallVisibilityMetadata(llvm::GlobalObject::VCallVisibilityLinkageUnit);
+    }
+
     auto class_type = compiler->get_name_resolver().get_class(class_name);
 
     auto instance = new VTable { class_type, instance_ptr, vtable_type };
@@ -7,6 +7,8 @@
 #include "types/VoidType.hpp"
 #include "types/IntegerTypes.hpp"
 #include "types/ArrayType.hpp"
+#include <utils/TimeReport.hpp>
+#include <algorithm>
 
 namespace dua
 {
@@ -40,6 +42,12 @@ void FunctionNameResolver::register_function(std::string name, FunctionInfo info
     if (!nomangle)
         name = get_function_full_name(name, info.type->param_types);
 
+    // The functions of libdua that terminate the program, matched by their exact
+    //  symbols, so that user functions that happen to share the name are not
+    //  affected. Marking them lets the optimizer treat the checks that call them
+    //  (e.g. the bounds checks of the containers) as unlikely branches.
+    bool is_noreturn = compiler->include_libdua && (name == "panic(i8*)" || (nomangle && name == "exit"));
+
     if (compiler->name_resolver.has_class(name))
         compiler->report_error("There is already a class with the name " + name + ". Can't have a function with the same name");
 
@@ -52,7 +60,12 @@ void FunctionNameResolver::register_function(std::string name, FunctionInfo info
     } else {
         llvm::FunctionType* type = info.type->llvm_type();
         llvm::Function* function = llvm::Function::Create(type, llvm::Function::ExternalLinkage, name, compiler->module);
+        if (is_noreturn) {
+            function->addFnAttr(llvm::Attribute::NoReturn);
+            function->addFnAttr(llvm::Attribute::Cold);
+        }
         llvm::verifyFunction(*function);
+        invalidate_overload_sets(name);
         functions[std::move(name)] = std::move(info);
     }
 }
@@ -542,19 +555,62 @@ llvm::IRBuilder<>& FunctionNameResolver::builder() const
     return compiler->builder;
 }
 
-std::string FunctionNameResolver::get_winning_function(const std::string &name, const std::vector<const Type*> &arg_types, bool panic_on_not_found, bool panic_on_ambiguity) const
+FunctionNameResolver::OverloadSet& FunctionNameResolver::get_overload_set(const std::string &name) const
 {
-    auto key = name;
-    if (name != "main") key += '(';
+    auto [it, inserted] = overload_sets.try_emplace(name);
+    auto& set = it->second;
+    if (!inserted)
+        return set;
+
+    auto non_mangled = functions.find(name);
+    if (non_mangled != functions.end())
+        set.non_mangled = Overload { &non_mangled->first, non_mangled->second.type };
+
+    // main is never mangled
+    if (name == "main")
+        return set;
+
+    auto key = name + '(';
     auto begin = functions.lower_bound(key);
     key.back()++;
     auto end = functions.lower_bound(key);
 
-    auto non_mangled = functions.find(name);
+    for (auto current = begin; current != end; current++)
+    {
+        Overload overload { &current->first, current->second.type };
+        set.mangled_count++;
+        if (overload.type->is_var_arg) {
+            set.var_arg.push_back(overload);
+        } else {
+            auto arity = overload.type->param_types.size();
+            if (arity >= set.by_arity.size())
+                set.by_arity.resize(arity + 1);
+            set.by_arity[arity].push_back(overload);
+        }
+    }
 
-    if (begin == end) {
+    return set;
+}
+
+void FunctionNameResolver::invalidate_overload_sets(const std::string &full_name)
+{
+    // The function can be resolved through its full name, and through
+    //  any prefix of it that is followed by the parameters list
+    overload_sets.erase(full_name);
+    for (size_t i = 0; i < full_name.size(); i++)
+        if (full_name[i] == '(')
+            overload_sets.erase(full_name.substr(0, i));
+}
 
-        if (non_mangled != functions.end()) {
+std::string FunctionNameResolver::get_winning_function(const std::string &name, const std::vector<const Type*> &arg_types, bool panic_on_not_found, bool panic_on_ambiguity) const
+{
+    add_to_counter("Overload resolutions");
+
+    auto& overloads = get_overload_set(name);
+
+    if (overloads.mangled_count == 0) {
+
+        if (overloads.non_mangled.has_value()) {
             // This is a non-mangled function name
             return name;
         }
@@ -565,31 +621,50 @@ std::string FunctionNameResolver::get_winning_function(const std::string &name,
         else return "";
     }
 
-    std::map<int, std::vector<std::pair<std::string, const FunctionType*>>> scores;
-
-    if (non_mangled != functions.end()) {
-        auto score = compiler->typing_system.type_list_similarity_score(arg_types, non_mangled->second.type->param_types);
-        if (score != -1)
-            scores[score].emplace_back(name, non_mangled->second.type);
+    // The argument types can be identifiers that refer to different
+    //  types in different contexts (e.g. template parameters), while
+    //  the parameter types are registered as concrete types
+    std::vector<const Type*> concrete_arg_types(arg_types.size());
+    for (size_t i = 0; i < arg_types.size(); i++)
+        concrete_arg_types[i] = arg_types[i]->get_concrete_type();
+
+    auto memo = overloads.resolutions.find(concrete_arg_types);
+    if (memo != overloads.resolutions.end()) {
+        auto& [winner, is_ambiguous] = memo->second;
+        // Failures are resolved again if they have to be reported
+        if (!winner.empty() || !(is_ambiguous ? panic_on_ambiguity : panic_on_not_found))
+            return winner;
     }
 
-    auto current = begin;
-    while (current != end)
-    {
-        auto& name = current->first;
-        auto& info = current->second;
-        current++;
+    int best_score = -1;
+    std::vector<Overload> best;
+
+    auto score = [&](const Overload& overload, bool can_differ_in_size) {
         auto score = compiler->typing_system.type_list_similarity_score(
-                arg_types,
-            info.type->param_types,
-            info.type->is_var_arg
+            arg_types,
+            overload.type->param_types,
+            can_differ_in_size
         );
-        if (score == -1) continue;
-        scores[score].emplace_back(name, info.type);
-    }
-
-    if (scores.empty())
+        if (score == -1 || (best_score != -1 && score > best_score))
+            return;
+        if (score != best_score)
+            best.clear();
+        best_score = score;
+        best.push_back(overload);
+    };
+
+    if (overloads.non_mangled.has_value())
+        score(*overloads.non_mangled, false);
+    if (arg_types.size() < overloads.by_arity.size())
+        for (auto& overload : overloads.by_arity[arg_types.size()])
+            score(overload, false);
+    for (auto& overload : overloads.var_arg)
+        score(overload, true);
+
+    if (best.empty())
     {
+        overloads.resolutions[std::move(concrete_arg_types)] = { "", false };
+
         if (!panic_on_not_found) return "";
 
         std::string message = "There are no applicable overloads for the function '" + name + "' with ";
@@ -606,7 +681,10 @@ std::string FunctionNameResolver::get_winning_function(const std::string &name,
 
         message += "\nFunction overloads are:\n";
 
-        current = begin;
+        auto key = name + '(';
+        auto current = functions.lower_bound(key);
+        key.back()++;
+        auto end = functions.lower_bound(key);
         while (current != end)
             message += current->second.type->to_string() + '\n', current++;
         message.pop_back();  // The extra '\n'
@@ -614,22 +692,26 @@ std::string FunctionNameResolver::get_winning_function(const std::string &name,
         compiler->report_error(message);
     }
 
-    auto& result_list = scores.begin()->second;
-
-    if (result_list.size() != 1)
+    if (best.size() != 1)
     {
+        overloads.resolutions[std::move(concrete_arg_types)] = { "", true };
+
         if (!panic_on_ambiguity) return "";
 
+        std::sort(best.begin(), best.end(), [](const Overload& a, const Overload& b) { return *a.name < *b.name; });
+
         std::string message = "More than one overload of the function '" + name + "' is applicable to the function call."
                                                                                  " Applicable functions are:\n";
-        for (auto& overload : result_list)
-            message += overload.second->to_string() + '\n';
+        for (auto& overload : best)
+            message += overload.type->to_string() + '\n';
         message.pop_back();  // The extra '\n'
 
         compiler->report_error(message);
     }
 
-    return result_list.front().first;
+    auto& winner = *best.front().name;
+    overloads.resolutions[std::move(concrete_arg_types)] = { winner, false };
+    return winner;
 }
 
 std::string FunctionNameResolver::get_function_full_name(std::string name, const std::vector<const Type*> &param_types)
@@ -747,6 +829,8 @@ std::string FunctionNameResolver::get_winning_method(const ClassType *owner, con
         return get_winning_function(owner->name + ".constructor", arg_types, panic_on_not_found, panic_on_ambiguity);
     }
 
+    add_to_counter("Overload resolutions");
+
     auto key = name + '(';
     auto vtable = compiler->name_resolver.get_vtable_instance(owner->name);
     auto begin = vtable->method_names_without_class_prefix.lower_bound(key);
@@ -831,7 +915,6 @@ void FunctionNameResolver::construct_array(const Value &ptr, const Value& count,
     // This must be a pointer type
     auto ptr_type = ptr.type->as<PointerType>();
     auto element_type = ptr_type->get_element_type();
-    auto alloc_type = element_type->llvm_type();
 
     auto condition_bb = compiler->create_basic_block("construct_condition");
     auto body_bb = compiler->create_basic_block("construct_loop");
@@ -842,7 +925,8 @@ void FunctionNameResolver::construct_array(const Value &ptr, const Value& count,
         compiler->report_error("The type " + count.type->to_string()
                                + " can't be used as the size of an array. (While allocating an array of " + element_type->to_string() + ")");
 
-    auto element_size = alloc_type->isSized() ? llvm::DataLayout(compiler->get_module()).getTypeAllocSize(alloc_type) : 1;
+    auto size_info = compiler->typing_system.get_size_info(element_type);
+    auto element_size = size_info.is_sized ? size_info.alloc_size : 1;
     llvm::Value* bytes = builder().getInt64(element_size);
     bytes = builder().CreateMul(as_i64.get(), bytes);
 
@@ -874,7 +958,6 @@ void FunctionNameResolver::copy_construct_array(const Value &to, const Value &fr
     // This must be a pointer type
     auto ptr_type = to.type->as<PointerType>();
     auto element_type = ptr_type->get_element_type();
-    auto alloc_type = element_type->llvm_type();
 
     auto condition_bb = compiler->create_basic_block("copy_construct_condition");
     auto body_bb = compiler->create_basic_block("copy_construct_loop");
@@ -885,7 +968,8 @@ void FunctionNameResolver::copy_construct_array(const Value &to, const Value &fr
         compiler->report_error("The type " + count.type->to_string()
                                + " can't be used as the size of an array. (While allocating an array of " + element_type->to_string() + ")");
 
-    auto element_size = alloc_type->isSized() ? llvm::DataLayout(compiler->get_module()).getTypeAllocSize(alloc_type) : 1;
+    auto size_info = compiler->typing_system.get_size_info(element_type);
+    auto element_size = size_info.is_sized ? size_info.alloc_size : 1;
     llvm::Value* bytes = builder().getInt64(element_size);
     bytes = builder().CreateMul(as_i64.get(), bytes);
 
@@ -0,0 +1,37 @@
+#include <resolution/InstantiationRegistry.hpp>
+#include <utils/TextManipulation.hpp>
+
+namespace dua
+{
+
+InstantiationRegistry::InstantiationRegistry(const std::vector<std::string> &module_names)
+{
+    for (size_t i = 0; i < module_names.size(); i++)
+        module_indices.try_emplace(module_names[i], i);
+}
+
+bool InstantiationRegistry::is_template_instance(const std::string &function_name)
+{
+    // Both the templated functions and the classes instantiated from
+    //  templated classes (and thus, their methods) have this prefix
+    return starts_with(function_name, "Templated.");
+}
+
+void InstantiationRegistry::add_definition(const std::string &function_name, const std::string &module_name)
+{
+    auto index = module_indices.at(module_name);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto [it, inserted] = owners.try_emplace(function_name, index);
+    if (!inserted && index < it->second)
+        it->second = index;
+}
+
+bool InstantiationRegistry::is_owner(const std::string &function_name, const std::string &module_name)
+{
+    auto index = module_indices.at(module_name);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = owners.find(function_name);
+    return it == owners.end() || it->second == index;
+}
+
+}
@@ -5,14 +5,15 @@ namespace dua
 {
 
 NameResolver::NameResolver(ModuleCompiler *compiler) : compiler(compiler), FunctionNameResolver(compiler), symbol_table(compiler),
-                                                       ClassResolver(compiler), TemplatedNameResolver(compiler) {}
+                                                       arena(compiler->arena), ClassResolver(compiler), TemplatedNameResolver(compiler) {}
 
 void NameResolver::destruct_all_variables(const Scope<Value> &scope)
 {
     size_t size = scope.map.size();
     if (size == 0) return;
     for (size_t i = size - 1; i != (size_t)-1; i--)
-        destruct(scope.map[i].value);
+        if (!scope.is_erased(i))
+            destruct(scope.map[i].value);
 }
 
 void NameResolver::push_scope()
@@ -25,9 +26,4 @@ Scope<Value> NameResolver::pop_scope()
     return symbol_table.pop_scope();
 }
 
-NameResolver::~NameResolver() {
-    for (auto str : resolution_strings)
-        delete str;
-}
-
 }
\ No newline at end of file
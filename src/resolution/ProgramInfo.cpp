@@ -0,0 +1,20 @@
+#include <resolution/ProgramInfo.hpp>
+
+namespace dua
+{
+
+ProgramInfo ProgramInfo::from_code(const std::vector<std::string>& code)
+{
+    ProgramInfo info;
+    info.is_single_module = code.size() == 1;
+
+    // A mention in a comment or a string literal only
+    //  disables the devirtualization, which is safe.
+    for (auto& file : code)
+        if (file.find("_set_vtable") != std::string::npos)
+            info.uses_set_vtable = true;
+
+    return info;
+}
+
+}
@@ -6,6 +6,7 @@
 #include <resolution/NameResolver.hpp>
 #include <types/ReferenceType.hpp>
 #include <parsing/ParserAssistant.hpp>
+#include <utils/TimeReport.hpp>
 
 namespace dua
 {
@@ -35,6 +36,8 @@ void TemplatedNameResolver::add_templated_function(FunctionDefinitionNode* node,
 {
     auto name = get_templated_function_key(node->name, template_params.size());
     check_template_params(template_params, "the function " + name);
+    // A new overload can be a better match for the previous lookups
+    templated_function_instances.erase(name);
     auto& functions = templated_functions[std::move(name)];
 //    for (auto& function : functions) {
 //        if (*function.info.type == *info.type) {
@@ -55,7 +58,8 @@ Value TemplatedNameResolver::get_templated_function(const std::string& name, std
     //  allow for functions with same signature, but with different number
     //  of template parameters to exist without collision
 
-    auto it = templated_functions.find(get_templated_function_key(name, template_args.size()));
+    auto key = get_templated_function_key(name, template_args.size());
+    auto it = templated_functions.find(key);
 
     if (it == templated_functions.end()) {
         if (!panic_on_error) return {};
@@ -72,6 +76,9 @@ Value TemplatedNameResolver::get_templated_function(const std::string& name, std
     for (auto& type : template_args)
         type = type->get_concrete_type();
 
+    if (auto instance = find_templated_function_instance(key, use_arg_types, template_args, arg_types); instance != nullptr)
+        return compiler->create_value(instance->function, instance->type);
+
     // Global scope. Other scopes such as the scopes of class fields, class type aliases,
     //  and class template args will be pushed later
     compiler->name_resolver.symbol_table.keep_only_last_n_scopes(0, true);
@@ -125,11 +132,15 @@ Value TemplatedNameResolver::get_templated_function(const std::string& name, std
         compiler->typing_system.identifier_types.restore_prev_state();
         compiler->name_resolver.symbol_table.restore_prev_state();
 
+        add_templated_function_instance(key, use_arg_types, template_args, arg_types, { (size_t)idx, func, type });
+
         return compiler->create_value(func, type);
     }
 
     // Function is not defined yet.
     // Instantiate the function with the provided arguments
+    PhaseTimer timer("Template instantiation");
+    add_to_counter("Templated functions instantiated");
 
     // Types shouldn't be cached during the evaluation of templated functions
     auto old_type_cache_config = compiler->stop_caching_types;
@@ -168,9 +179,31 @@ Value TemplatedNameResolver::get_templated_function(const std::string& name, std
     auto func = compiler->module.getFunction(full_name);
     auto type = compiler->name_resolver.get_function_no_overloading(full_name).type;
 
+    add_templated_function_instance(key, use_arg_types, template_args, arg_types, { (size_t)idx, func, type });
+
     return compiler->create_value(func, type);
 }
 
+const TemplatedNameResolver::TemplatedFunctionInstance* TemplatedNameResolver::find_templated_function_instance(const std::string& key,
+    bool use_arg_types, const std::vector<const Type*>& template_args, const std::vector<const Type*>& arg_types) const
+{
+    auto instances = templated_function_instances.find(key);
+    if (instances == templated_function_instances.end())
+        return nullptr;
+    auto instance = instances->second.find(std::forward_as_tuple(use_arg_types, template_args, arg_types));
+    if (instance == instances->second.end())
+        return nullptr;
+    add_to_counter("Template instance cache hits");
+    return &instance->second;
+}
+
+void TemplatedNameResolver::add_templated_function_instance(const std::string& key, bool use_arg_types,
+    const std::vector<const Type*>& template_args, const std::vector<const Type*>& arg_types, TemplatedFunctionInstance instance)
+{
+    // Looked up again since instantiating a function can add overloads
+    templated_function_instances[key].emplace(TemplatedFunctionInstanceKey { use_arg_types, template_args, arg_types }, instance);
+}
+
 Value TemplatedNameResolver::get_templated_function(const std::string& name, const std::vector<const Type *>& template_args, bool panic_on_error) {
     return get_templated_function(name, template_args, std::vector<const Type*>{}, false, panic_on_error);
 }
@@ -191,6 +224,8 @@ std::string TemplatedNameResolver::get_templated_function_full_name(std::string
 
 long long TemplatedNameResolver::get_winner_templated_function(const std::string& name, const std::vector<TemplatedFunctionNode> &functions, const std::vector<const Type*>& template_args, const std::vector<const Type *> &arg_types, bool panic_on_not_found)
 {
+    add_to_counter("Overload resolutions");
+
     std::map<int, std::vector<long long>> scores;
 
     for (size_t i = 0; i < functions.size(); i++)
@@ -273,6 +308,14 @@ void TemplatedNameResolver::add_templated_class(ClassDefinitionNode* node, std::
     templated_classes[std::move(name)] = { node, std::move(template_params), std::move(parent) };
 }
 
+bool TemplatedNameResolver::has_templated_subclasses() const
+{
+    for (auto& [name, cls] : templated_classes)
+        if (cls.parent != nullptr && cls.parent->name != "Object")
+            return true;
+    return false;
+}
+
 const ClassType* TemplatedNameResolver::get_templated_class(const std::string &name, const std::vector<const Type*>& template_args)
 {
     auto key = get_templated_class_key(name, template_args.size());
@@ -282,6 +325,13 @@ const ClassType* TemplatedNameResolver::get_templated_class(const std::string &n
 
     auto& templated = it->second;
 
+    if (auto instances = templated_class_instances.find(key); instances != templated_class_instances.end()) {
+        if (auto instance = instances->second.find(template_args); instance != instances->second.end()) {
+            add_to_counter("Template instance cache hits");
+            return instance->second;
+        }
+    }
+
     compiler->name_resolver.symbol_table.keep_only_last_n_scopes(0, true);
     compiler->typing_system.identifier_types.keep_only_last_n_scopes(0, true);
 
@@ -313,6 +363,10 @@ const ClassType* TemplatedNameResolver::get_templated_class(const std::string &n
     compiler->typing_system.identifier_types.restore_prev_state();
     compiler->name_resolver.symbol_table.restore_prev_state();
 
+    // The template args are the ones passed, not the concrete ones,
+    //  since they are resolved after the scopes are switched
+    templated_class_instances[key][template_args] = cls;
+
     return cls;
 }
 
@@ -339,6 +393,9 @@ TemplatedClassMethodInfo TemplatedNameResolver::get_templated_class_method_info(
 
 void TemplatedNameResolver::register_templated_class(const std::string &name, const std::vector<const Type *> &template_args)
 {
+    PhaseTimer timer("Template instantiation");
+    add_to_counter("Templated classes instantiated");
+
     auto key = get_templated_class_key(name, template_args.size());
     auto it = templated_classes.find(key);
     if (it == templated_classes.end())
@@ -474,6 +531,8 @@ void TemplatedNameResolver::register_templated_class(const std::string &name, co
 
 const ClassType* TemplatedNameResolver::define_templated_class(const std::string &name, const std::vector<const Type *> &template_args)
 {
+    PhaseTimer timer("Template instantiation");
+
     auto key = get_templated_class_key(name, template_args.size());
     auto it = templated_classes.find(key);
     if (it == templated_classes.end())
@@ -773,7 +832,8 @@ bool TemplatedNameResolver::is_templated_class_defined(const std::string &name,
 
 Value TemplatedNameResolver::call_templated_function(const std::string &name, std::vector<const Type*> template_args, std::vector<Value> args, bool panic_on_error)
 {
-    auto it = templated_functions.find(get_templated_function_key(name, template_args.size()));
+    auto key = get_templated_function_key(name, template_args.size());
+    auto it = templated_functions.find(key);
 
     if (it == templated_functions.end()) {
         if (panic_on_error)
@@ -791,6 +851,14 @@ Value TemplatedNameResolver::call_templated_function(const std::string &name, st
     for (auto& type : template_args)
         type = type->get_concrete_type();
 
+    std::vector<const Type*> arg_types(args.size());
+    for (size_t i = 0; i < args.size(); i++)
+        arg_types[i] = args[i].type;
+
+    // The scopes are still switched for the call below,
+    //  but the resolution of the overload is skipped
+    auto instance = find_templated_function_instance(key, true, template_args, arg_types);
+
     // Global scope. Other scopes such as the scopes of class fields, class type aliases,
     //  and class template args will be pushed later
     compiler->name_resolver.symbol_table.keep_only_last_n_scopes(0, true);
@@ -807,11 +875,11 @@ Value TemplatedNameResolver::call_templated_function(const std::string &name, st
             compiler->typing_system.insert_type(bindings.params[i], bindings.args[i]);
     }
 
-    std::vector<const Type*> arg_types(args.size());
-    for (size_t i = 0; i < args.size(); i++)
-        arg_types[i] = args[i].type;
-
-    auto idx = get_winner_templated_function(name, functions, template_args, std::move(arg_types));
+    size_t idx;
+    if (instance != nullptr)
+        idx = instance->overload;
+    else
+        idx = get_winner_templated_function(name, functions, template_args, arg_types);
 
     auto& templated = functions[idx];
 
@@ -824,12 +892,25 @@ Value TemplatedNameResolver::call_templated_function(const std::string &name, st
     for (size_t i = 0; i < template_args.size(); i++)
         compiler->typing_system.insert_type(templated.template_params[i], template_args[i]);
 
+    if (instance != nullptr)
+    {
+        auto value = compiler->create_value(instance->function, instance->type);
+        // Calling the function while the template args are still bound
+        auto result = compiler->name_resolver.call_function(value, std::move(args));
+
+        compiler->typing_system.identifier_types.restore_prev_state();
+        compiler->name_resolver.symbol_table.restore_prev_state();
+
+        return result;
+    }
+
     std::string full_name = get_templated_function_full_name(name, template_args, templated.info.type->param_types);
 
     if (compiler->name_resolver.has_function(full_name))
     {
         auto func = compiler->module.getFunction(full_name);
         auto type = compiler->name_resolver.get_function_no_overloading(full_name).type;
+        add_templated_function_instance(key, true, template_args, arg_types, { idx, func, type });
         auto value = compiler->create_value(func, type);
         // Calling the function while the template args are still bound
         auto result = compiler->name_resolver.call_function(value, std::move(args));
@@ -874,6 +955,7 @@ Value TemplatedNameResolver::call_templated_function(const std::string &name, st
 
     auto func = compiler->module.getFunction(full_name);
     auto type = compiler->name_resolver.get_function_no_overloading(full_name).type;
+    add_templated_function_instance(key, true, template_args, arg_types, { idx, func, type });
     auto value = compiler->create_value(func, type);
     // Calling the function while the template args are still bound
     auto result = compiler->name_resolver.call_function(value, std::move(args));
@@ -26,6 +26,7 @@ Value ArrayType::zero_value() const {
 }
 
 bool ArrayType::operator==(const Type &other) const {
+    if (this == &other) return true;
     auto as_arr = other.as<ArrayType>();
     return as_arr && element_type == as_arr->element_type && size == as_arr->size;
 }
@@ -3,6 +3,9 @@
 #include <ModuleCompiler.hpp>
 #include "types/PointerType.hpp"
 #include "types/ReferenceType.hpp"
+#include <utils/TimeReport.hpp>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/MDBuilder.h>
 
 namespace dua
 {
@@ -13,8 +16,9 @@ ClassType::ClassType(ModuleCompiler *compiler, std::string name)
     this->compiler = compiler;
 
     // Just to make sure the type is declared before usage.
-    if (llvm::StructType::getTypeByName(*compiler->get_context(), this->name) == nullptr)
-        llvm::StructType::create(compiler->context, this->name);
+    struct_type = llvm::StructType::getTypeByName(*compiler->get_context(), this->name);
+    if (struct_type == nullptr)
+        struct_type = llvm::StructType::create(compiler->context, this->name);
 }
 
 Value ClassType::default_value() const
@@ -24,31 +28,50 @@ Value ClassType::default_value() const
 }
 
 llvm::StructType* ClassType::llvm_type() const {
-    return llvm::StructType::getTypeByName(*compiler->get_context(), name);
+    return struct_type;
 }
 
-const std::vector<ClassField> &ClassType::fields() const {
-    return compiler->name_resolver.class_fields[name];
+const std::vector<ClassField> &ClassType::fields() const
+{
+    // The references to the elements of the map stay valid
+    if (field_table == nullptr)
+        field_table = &compiler->name_resolver.class_fields[name];
+    return *field_table;
 }
 
-const ClassField& ClassType::get_field(const std::string &name) const {
-    for (auto & field : fields()) {
-        if (field.name == name)
-            return field;
+int ClassType::get_field_index(const std::string &name) const
+{
+    auto& f = fields();
+
+    // The fields are only added while parsing the class, and the whole list is replaced
+    //  once the layout is constructed (with the vtable and the fields of the parent in
+    //  the beginning), which makes it longer. Either way, the index is out of date.
+    if (indexed_fields_count != f.size()) {
+        field_indices.clear();
+        field_indices.reserve(f.size());
+        for (size_t i = 0; i < f.size(); i++)
+            field_indices.emplace(f[i].name, i);
+        indexed_fields_count = f.size();
     }
-    compiler->report_error("Class " + this->name + " doesn't contain a member with the name " + name);
 
-    // Unreachable
-    return fields().front();
+    auto it = field_indices.find(name);
+    return (it == field_indices.end()) ? -1 : (int)it->second;
 }
 
-Value ClassType::get_field(const Value& instance, const std::string &name) const {
-    for (size_t i = 0; i < fields().size(); i++) {
-        if (fields()[i].name == name)
-            return get_field(instance, i);
-    }
-    compiler->report_error("Class " + this->name + " doesn't contain a member with the name " + name);
-    return {};
+const ClassField& ClassType::get_field(const std::string &name) const
+{
+    auto index = get_field_index(name);
+    if (index == -1)
+        compiler->report_error("Class " + this->name + " doesn't contain a member with the name " + name);
+    return fields()[index];
+}
+
+Value ClassType::get_field(const Value& instance, const std::string &name) const
+{
+    auto index = get_field_index(name);
+    if (index == -1)
+        compiler->report_error("Class " + this->name + " doesn't contain a member with the name " + name);
+    return get_field(instance, index);
 }
 
 Value ClassType::get_field(const Value& instance, size_t index) const
@@ -77,7 +100,7 @@ int ClassType::ancestor_distance(const ClassType *ancestor) const {
     return -1;
 }
 
-Value ClassType::get_method(const std::string& name, Value instance, const std::vector<const Type*>& arg_types, bool panic_on_error) const
+Value ClassType::get_method(const std::string& name, Value instance, const std::vector<const Type*>& arg_types, bool panic_on_error, bool is_exact_type) const
 {
     // Load the symbol table. The symbol table may be of a child class.
     // The type tho, will be considered of the current class
@@ -88,6 +111,17 @@ Value ClassType::get_method(const std::string& name, Value instance, const std::
         return {};
     }
 
+    auto full_name = compiler->name_resolver.get_winning_method(this, name, arg_types);
+    auto method_type = compiler->name_resolver.get_function(full_name, arg_types).type;
+
+    // Constructors are not in the vtable, and are always called directly
+    bool is_leaf = name != "constructor" && !compiler->may_change_vtables() && compiler->is_leaf_class(this);
+    if (name == "constructor" || is_exact_type || is_leaf) {
+        if (name != "constructor")
+            add_to_counter("Devirtualized calls");
+        return compiler->create_value(compiler->module.getFunction(full_name), method_type);
+    }
+
     if (auto ref = instance.type->as<ReferenceType>(); ref != nullptr) {
         if (!ref->is_allocated()) {
             assert(instance.memory_location != nullptr);
@@ -101,12 +135,41 @@ Value ClassType::get_method(const std::string& name, Value instance, const std::
     auto vtable_ptr_ptr = get_field(instance, ".vtable_ptr");
     auto vtable_type = compiler->name_resolver.get_vtable_type(this->name)->llvm_type();
     auto vtable_ptr = compiler->builder.CreateLoad(vtable_type, vtable_ptr_ptr.get(), ".vtable");
+
+    if (compiler->whole_program) {
+        // Tells the whole program devirtualization pass that the vtable is compatible with
+        //  this class, so that it can call the method directly if it has only one
+        //  implementation in the program. The test is dropped if it's not used.
+        auto& context = compiler->context;
+        auto type_id = llvm::MetadataAsValue::get(context, llvm::MDString::get(context, this->name));
+        auto as_i8_ptr = compiler->builder.CreateBitCast(vtable_ptr, compiler->builder.getInt8PtrTy());
+        auto test = compiler->builder.CreateIntrinsic(llvm::Intrinsic::type_test, {}, { as_i8_ptr, type_id });
+        compiler->builder.CreateIntrinsic(llvm::Intrinsic::assume, {}, { test });
+    }
+
+    auto method_ptr = vtable->get_method(full_name, method_type->llvm_type()->getPointerTo(), vtable_ptr);
+    return compiler->create_value(method_ptr, method_type);
+}
+
+void ClassType::add_callees_metadata(const Value& method, const std::string& name, const std::vector<const Type*>& arg_types) const
+{
+    // A direct call has one target already
+    auto method_ptr = method.get();
+    if (method_ptr == nullptr || llvm::isa<llvm::Function>(method_ptr))
+        return;
+
+    if (!compiler->knows_all_subclasses() || compiler->may_change_vtables())
+        return;
+
     auto full_name = compiler->name_resolver.get_winning_method(this, name, arg_types);
-    auto method_type = compiler->name_resolver.get_function(full_name, arg_types).type;
-    auto method_ptr = (name != "constructor") ? vtable->get_method(full_name, method_type->llvm_type()->getPointerTo(), vtable_ptr)
-                : compiler->module.getFunction(full_name);
-    auto method = compiler->create_value(method_ptr, method_type);
-    return method;
+    auto implementations = compiler->name_resolver.get_method_implementations(this->name, full_name);
+    if (implementations.empty())
+        return;
+
+    auto callees = llvm::MDBuilder(compiler->context).createCallees(implementations);
+    for (auto user : method_ptr->users())
+        if (auto call = llvm::dyn_cast<llvm::CallBase>(user); call != nullptr && call->getCalledOperand() == method_ptr)
+            call->setMetadata(llvm::LLVMContext::MD_callees, callees);
 }
 
 Value ClassType::zero_value() const
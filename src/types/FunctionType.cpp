@@ -59,6 +59,7 @@ std::string FunctionType::as_key() const
 
 bool FunctionType::operator==(const Type &other) const
 {
+    if (this == &other) return true;
     auto other_func = other.as<FunctionType>();
     if (other_func == nullptr) return false;
     if (*return_type != *other_func->return_type) return false;
@@ -31,6 +31,7 @@ llvm::Type *IdentifierType::llvm_type() const {
 }
 
 bool IdentifierType::operator==(const Type &other) const {
+    if (this == &other) return true;
     return *get_concrete_type() == *other.get_concrete_type();
 }
 
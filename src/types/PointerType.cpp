@@ -23,6 +23,7 @@ llvm::PointerType* PointerType::llvm_type() const {
 
 bool PointerType::operator==(const Type& other) const
 {
+    if (this == &other) return true;
     if (auto casted = other.as<PointerType>(); casted != nullptr)
         return *get_element_type() == *casted->get_element_type();
     return false;
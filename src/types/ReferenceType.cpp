@@ -14,6 +14,7 @@ dua::Value ReferenceType::default_value() const {
 }
 
 bool ReferenceType::operator==(const Type &other) const {
+    if (this == &other) return true;
     auto ref = (&other)->as<ReferenceType>();
     // Being allocated or not doesn't affect comparisons
     return ref && *ref->element_type == *element_type;
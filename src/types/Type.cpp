@@ -9,6 +9,9 @@ namespace dua
 
 bool Type::operator==(const Type &other) const
 {
+    // Types are interned, so this covers most of the comparisons
+    if (this == &other) return true;
+
     auto c1 = get_concrete_type();
     auto c2 = other.get_concrete_type();
 
@@ -0,0 +1,43 @@
+#include <utils/Arena.hpp>
+#include <cstdlib>
+#include <new>
+
+namespace dua
+{
+
+void* Arena::allocate_in_new_block(size_t size, size_t alignment)
+{
+    // Objects larger than a block get a block of their own, and
+    //  the current block keeps being used for the smaller ones
+    bool dedicated = size + alignment > next_block_size;
+    size_t block_size = dedicated ? size + alignment : next_block_size;
+
+    auto block = static_cast<char*>(std::malloc(block_size));
+    if (block == nullptr)
+        throw std::bad_alloc();
+    blocks.push_back(block);
+
+    auto address = (reinterpret_cast<uintptr_t>(block) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    auto result = reinterpret_cast<char*>(address);
+    allocated_size += size;
+
+    if (!dedicated) {
+        current = result + size;
+        end = block + block_size;
+        // Grow geometrically, so that big modules don't need many blocks
+        if (next_block_size < 4 * 1024 * 1024)
+            next_block_size *= 2;
+    }
+
+    return result;
+}
+
+Arena::~Arena()
+{
+    for (auto it = destructors.rbegin(); it != destructors.rend(); it++)
+        it->destroy(it->object);
+    for (auto block : blocks)
+        std::free(block);
+}
+
+}
@@ -10,8 +10,22 @@
 #include <utils/TextManipulation.hpp>
 #include <ModuleCompiler.hpp>
 #include <Preprocessor.hpp>
+#include <utils/ErrorReporting.hpp>
+#include <utils/NativeBackend.hpp>
+#include <utils/CompilationCache.hpp>
+#include <resolution/InstantiationRegistry.hpp>
+#include <resolution/ProgramInfo.hpp>
+#include <utils/JITExecution.hpp>
+#include <utils/TimeReport.hpp>
+#include <utils/termcolor.hpp>
 #include <boost/process.hpp>
 #include <boost/filesystem.hpp>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/Host.h>
+#include <sstream>
+#include <functional>
+#include <cstring>
+#include <set>
 
 #ifdef _WIN32
 #include <stdlib.h>
@@ -42,15 +56,193 @@ std::string uuid()
     return boost::uuids::to_string(generator());
 }
 
-void generate_llvm_ir(const strings& filename, const strings& code, bool include_libdua)
+// Runs process(i) for each module i, on up to the given number of jobs
+static void for_each_module(size_t n, size_t jobs, const std::function<void(size_t)>& process)
+{
+    if (jobs == 1 || n == 1) {
+        for (size_t i = 0; i < n; i++)
+            process(i);
+        return;
+    }
+
+    // Each ModuleCompiler owns its own LLVMContext, so the modules
+    //  can be compiled concurrently. The diagnostics of each module
+    //  are buffered, and are reported in the order of the files after
+    //  all of them are done, to keep the output deterministic.
+    bool colorize = termcolor::_internal::is_atty(std::cerr);
+    strings diagnostics(n);
+    std::vector<std::exception_ptr> errors(n);
+
+    // jobs = 0 means using all the available hardware threads
+    llvm::ThreadPool pool(llvm::hardware_concurrency(jobs));
+    for (size_t i = 0; i < n; i++) {
+        pool.async([&, i] {
+            std::ostringstream stream;
+            if (colorize)
+                stream << termcolor::colorize;
+            set_diagnostics_stream(&stream);
+            try {
+                process(i);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+            set_diagnostics_stream(nullptr);
+            diagnostics[i] = stream.str();
+        });
+    }
+    pool.wait();
+
+    for (auto& diagnostic : diagnostics)
+        std::cerr << diagnostic;
+
+    // Report the error of the first file that has failed
+    for (auto& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+}
+
+void generate_llvm_ir(const strings& filename, const strings& code, bool include_libdua, size_t jobs)
 {
     assert(filename.size() == code.size());
-    for (size_t i = 0; i < filename.size(); i++) {
-        // TODO This is a great candidate for multithreading
+    register_file_reports(filename);
+    for_each_module(filename.size(), jobs, [&](size_t i) {
+        FileTimeReportScope report_scope(i);
         dua::ModuleCompiler compiler(filename[i], code[i], include_libdua);
         std::ofstream output(filename[i]);
         output << compiler.get_result();
         output.close();
+    });
+}
+
+// Everything, other than the code, that affects the output of a module
+static strings get_cache_key_components(const std::string& module_name, const std::string& code,
+                                        OutputKind kind, const CompilationOptions& options, const ProgramInfo* program)
+{
+    auto triple = options.target_triple.empty() ? llvm::sys::getDefaultTargetTriple() : options.target_triple;
+    auto program_str = program == nullptr ? std::string("unknown")
+            : std::to_string(program->uses_set_vtable) + std::to_string(program->is_single_module);
+    return {
+        module_name,
+        code,
+        triple,
+        std::to_string((int)kind),
+        std::to_string((int)options.optimization_level),
+        std::to_string(options.include_libdua),
+        program_str,
+    };
+}
+
+void emit_modules(const strings& module_names, const strings& code, const strings& output_paths, OutputKind kind,
+                  const CompilationOptions& options)
+{
+    assert(module_names.size() == code.size() && code.size() == output_paths.size());
+    initialize_native_backend();
+
+    std::unique_ptr<CompilationCache> cache;
+    if (!options.cache_directory.empty())
+        cache = std::make_unique<CompilationCache>(options.cache_directory);
+    auto extension = get_output_extension(kind);
+
+    // The owner of an instance depends on the other modules of the build, which
+    //  is not part of the cache key, so instances are not shared when caching
+    std::unique_ptr<InstantiationRegistry> registry;
+    if (options.share_template_instances && !cache)
+        registry = std::make_unique<InstantiationRegistry>(module_names);
+
+    std::unique_ptr<ProgramInfo> program;
+    if (options.has_all_dua_files)
+        program = std::make_unique<ProgramInfo>(ProgramInfo::from_code(code));
+
+    auto finish_module = [&](size_t i, ModuleCompiler& compiler, const std::string& key) {
+        // A target machine is not meant to be shared between threads
+        auto target_machine = create_target_machine(options.target_triple, options.optimization_level);
+        {
+            PhaseTimer timer("Optimization");
+            optimize_module(*compiler.get_module(), *target_machine, options.optimization_level, options.print_pipeline_timings);
+        }
+        {
+            PhaseTimer timer("Emission");
+            emit_module(*compiler.get_module(), *target_machine, kind, output_paths[i]);
+        }
+
+        if (cache)
+            cache->store(key, extension, output_paths[i]);
+    };
+
+    // The owners of the instances are known once all the modules are
+    //  generated, so the modules are kept until then when sharing them
+    std::vector<std::unique_ptr<ModuleCompiler>> compilers(module_names.size());
+    for_each_module(module_names.size(), options.jobs, [&](size_t i) {
+        FileTimeReportScope report_scope(i);
+
+        std::string key;
+        if (cache) {
+            PhaseTimer timer("Cache lookup");
+            key = CompilationCache::compute_key(get_cache_key_components(module_names[i], code[i], kind, options, program.get()));
+            if (cache->fetch(key, extension, output_paths[i])) {
+                add_to_counter("Cache hits");
+                return;
+            }
+        }
+
+        auto compiler = std::make_unique<ModuleCompiler>(module_names[i], code[i], options.include_libdua, registry.get(),
+                                                         false, program.get());
+        if (registry)
+            compilers[i] = std::move(compiler);
+        else
+            finish_module(i, *compiler, key);
+    });
+
+    if (!registry)
+        return;
+
+    for_each_module(module_names.size(), options.jobs, [&](size_t i) {
+        FileTimeReportScope report_scope(i);
+        compilers[i]->declare_instances_owned_elsewhere();
+        finish_module(i, *compilers[i], "");
+        compilers[i].reset();
+    });
+}
+
+void emit_whole_program(const strings& module_names, const strings& code, const std::string& output_path, OutputKind kind,
+                        const CompilationOptions& options)
+{
+    assert(module_names.size() == code.size());
+    initialize_native_backend();
+
+    // Nothing outside of the program can use the instances of a module,
+    //  or derive from its classes, as the vtables' visibility states
+    InstantiationRegistry registry(module_names);
+    auto program_info = ProgramInfo::from_code(code);
+
+    std::vector<std::unique_ptr<ModuleCompiler>> compilers(module_names.size());
+    for_each_module(module_names.size(), options.jobs, [&](size_t i) {
+        FileTimeReportScope report_scope(i);
+        compilers[i] = std::make_unique<ModuleCompiler>(module_names[i], code[i], options.include_libdua, &registry, true, &program_info);
+    });
+    for (auto& compiler : compilers)
+        compiler->declare_instances_owned_elsewhere();
+
+    llvm::LLVMContext context;
+    std::unique_ptr<llvm::Module> program;
+    {
+        PhaseTimer timer("Linking in memory");
+        std::vector<const llvm::Module*> modules(compilers.size());
+        for (size_t i = 0; i < compilers.size(); i++)
+            modules[i] = compilers[i]->get_module();
+        program = link_modules(modules, std::filesystem::path(output_path).stem().string(), context);
+        compilers.clear();
+        internalize_module(*program);
+    }
+
+    auto target_machine = create_target_machine(options.target_triple, options.optimization_level);
+    {
+        PhaseTimer timer("Optimization");
+        optimize_module(*program, *target_machine, options.optimization_level, options.print_pipeline_timings, true);
+    }
+    {
+        PhaseTimer timer("Emission");
+        emit_module(*program, *target_machine, kind, output_path);
     }
 }
 
@@ -80,7 +272,9 @@ std::string get_program_location()
     return path;
 #else
     char path[PATH_MAX]; // create a buffer to store the path
-    ssize_t len = readlink("/proc/self/exe", path, sizeof(path)); // read the symbolic
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1); // read the symbolic
+    // readlink doesn't null-terminate the path
+    path[len < 0 ? 0 : len] = '\0';
     return path;
 #endif
 }
@@ -105,10 +299,11 @@ int run_clang(const std::vector<std::string>& args, bool include_libdua)
     std::string system_specific_flags = "-lm ";
 #endif
 
+    PhaseTimer timer("Clang");
     return std::system((get_clang_name() + " " + system_specific_flags + concatenated).c_str());
 }
 
-bool run_clang_on_llvm_ir(const strings& filename, const strings& code, const strings& args, bool include_libdua, bool use_temp)
+bool run_clang_on_llvm_ir(const strings& filename, const strings& code, const strings& args, bool include_libdua, bool use_temp, size_t jobs)
 {
     auto directory = (use_temp ? std::filesystem::temp_directory_path().string() : "");
 
@@ -126,7 +321,7 @@ bool run_clang_on_llvm_ir(const strings& filename, const strings& code, const st
 
     try {
         // If the library is not included, no declarations should be included
-        generate_llvm_ir(names, code, include_libdua);
+        generate_llvm_ir(names, code, include_libdua, jobs);
     } catch (std::exception& e) {
         // This assumes that the compiler has already reported the error.
         std::filesystem::current_path(old_path);
@@ -143,7 +338,84 @@ bool run_clang_on_llvm_ir(const strings& filename, const strings& code, const st
     return true;
 }
 
-void compile(const strings& source_files, const strings& args, bool include_libdua)
+// Whether there are input files (other than .dua files, which are
+//  not passed in the args) that are meant to be processed by clang
+static size_t count_input_files(const strings& args)
+{
+    // Options that take their value as a separate argument
+    static const std::set<std::string> options_with_values = {
+        "-o", "-target", "-x", "-I", "-L", "-l", "-include", "-isystem",
+        "-Xlinker", "-Xclang", "-Xassembler", "-MF", "-MT", "-MQ"
+    };
+
+    size_t count = 0;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (options_with_values.count(args[i]))
+            i++;
+        else if (!args[i].empty() && args[i][0] != '-')
+            count++;
+    }
+
+    return count;
+}
+
+static bool has_input_files(const strings& args)
+{
+    return count_input_files(args) != 0;
+}
+
+// Sets the level if the argument is an optimization level flag
+static bool parse_optimization_flag(const std::string& arg, OptimizationLevel& level)
+{
+    if (arg == "-O0")
+        level = OptimizationLevel::O0;
+    else if (arg == "-O1")
+        level = OptimizationLevel::O1;
+    else if (arg == "-O2")
+        level = OptimizationLevel::O2;
+    else if (arg == "-O3")
+        level = OptimizationLevel::O3;
+    else if (arg == "-Os")
+        level = OptimizationLevel::Os;
+    else if (arg == "-Oz")
+        level = OptimizationLevel::Oz;
+    else
+        return false;
+    return true;
+}
+
+// Preprocesses each file, recording the time in the report of its module
+static strings preprocess_files(const strings& source_files, const strings& module_names, size_t jobs)
+{
+    // The files that are imported by multiple files are only read once
+    ImportGraph graph;
+    strings code(source_files.size());
+    for_each_module(source_files.size(), jobs, [&](size_t i) {
+        FileTimeReportScope report_scope(i);
+        PhaseTimer timer("Preprocessing");
+        Preprocessor preprocessor(&graph);
+        code[i] = preprocessor.process_file(source_files[i]).str();
+    });
+    return code;
+}
+
+static void start_time_report(const CompilationOptions& options)
+{
+    if (options.time_report)
+        enable_time_report();
+    if (!options.time_trace_file.empty())
+        enable_time_trace();
+}
+
+static void finish_time_report(const CompilationOptions& options)
+{
+    if (options.time_report)
+        print_time_reports(std::cerr);
+    if (!options.time_trace_file.empty())
+        write_time_trace(options.time_trace_file);
+}
+
+void compile(const strings& source_files, const strings& args, CompilationOptions options)
 {
     size_t n = source_files.size();
 
@@ -154,13 +426,167 @@ void compile(const strings& source_files, const strings& args, bool include_libd
         stripped[i] = filename.substr(0, filename.size() - 4);
     }
 
-    Preprocessor preprocessor;
-    strings code(n);
+    // The Dua files are emitted in-process. Clang is only used for
+    //  linking, and for the input files that are not Dua files.
+    bool only_assemble = false, only_compile = false, emit_llvm = false;
+    std::string output;
+    for (size_t i = 0; i < args.size(); i++) {
+        // The optimization level flags are still passed
+        //  to clang, to be applied to the non-Dua files
+        if (parse_optimization_flag(args[i], options.optimization_level))
+            continue;
+
+        if (args[i] == "-S")
+            only_assemble = true;
+        else if (args[i] == "-c")
+            only_compile = true;
+        else if (args[i] == "-emit-llvm")
+            emit_llvm = true;
+        else if (starts_with(args[i], "--target="))
+            options.target_triple = args[i].substr(std::strlen("--target="));
+        else if ((args[i] == "-target" || args[i] == "-o") && i + 1 < args.size())
+            (args[i] == "-o" ? output : options.target_triple) = args[++i];
+    }
+
+    if (options.cache_directory.empty()) {
+        if (auto directory = std::getenv("DUA_CACHE"); directory != nullptr)
+            options.cache_directory = directory;
+    }
+
+    start_time_report(options);
+    auto build_timer = std::make_unique<PhaseTimer>("Whole build");
+
+    try {
+        // Same as clang, which otherwise overwrites the output with each file
+        size_t dua_outputs = options.whole_program ? std::min<size_t>(n, 1) : n;
+        if ((only_assemble || only_compile) && !output.empty() && dua_outputs + count_input_files(args) > 1)
+            report_error("cannot specify -o when generating multiple output files");
+
+        auto module_names = stripped + ".dua";
+        register_file_reports(module_names);
+        auto code = preprocess_files(source_files, module_names, options.jobs);
+
+        if (only_assemble || only_compile)
+        {
+            OutputKind kind;
+            if (emit_llvm)
+                kind = only_assemble ? OutputKind::LLVM_IR : OutputKind::BITCODE;
+            else
+                kind = only_assemble ? OutputKind::ASSEMBLY : OutputKind::OBJECT;
+
+            bool other_inputs = has_input_files(args);
+
+            auto outputs = stripped + get_output_extension(kind);
+            if (n == 1 && !other_inputs && !output.empty())
+                outputs[0] = output;
+
+            if (options.whole_program && n != 0) {
+                // One output for all the files, named after the first one
+                auto whole_output = (!other_inputs && !output.empty()) ? output : outputs[0];
+                emit_whole_program(module_names, code, whole_output, kind, options);
+            } else {
+                emit_modules(module_names, code, outputs, kind, options);
+            }
+
+            if (other_inputs)
+                run_clang(args, false);
+        }
+        else
+        {
+            auto directory = std::filesystem::temp_directory_path() / uuid();
+            std::filesystem::create_directory(directory);
+
+            strings objects(n);
+            for (size_t i = 0; i < n; i++)
+                objects[i] = (directory / (stripped[i] + ".o")).string();
+            if (options.whole_program && n != 0)
+                objects.resize(1);
+
+            // The objects are only linked into the output. When optimizing, each
+            //  module keeps its own instances, so that they can be inlined
+            options.share_template_instances = options.optimization_level == OptimizationLevel::O0;
+            options.has_all_dua_files = !has_input_files(args);
+
+            try {
+                if (options.whole_program && n != 0)
+                    emit_whole_program(module_names, code, objects[0], OutputKind::OBJECT, options);
+                else
+                    emit_modules(module_names, code, objects, OutputKind::OBJECT, options);
+            } catch (...) {
+                std::filesystem::remove_all(directory);
+                throw;
+            }
+
+            run_clang(objects + args, options.include_libdua);
+
+            std::filesystem::remove_all(directory);
+        }
+    } catch (ReportedError&) {
+        exit(1);
+    } catch (std::exception& e) {
+        std::cerr << e.what() << '\n';
+        exit(1);
+    }
+
+    build_timer.reset();
+    finish_time_report(options);
+}
+
+int run(const strings& source_files, const strings& args, const strings& program_args, CompilationOptions options)
+{
+    for (auto& arg : args) {
+        if (!parse_optimization_flag(arg, options.optimization_level)) {
+            std::cerr << termcolor::red << "Fatal error" << termcolor::reset <<
+                ": unsupported option " << arg << " when running a program\n";
+            exit(1);
+        }
+    }
+
+    size_t n = source_files.size();
+    if (n == 0) {
+        std::cerr << termcolor::red << "Fatal error" << termcolor::reset << ": no input files to run\n";
+        exit(1);
+    }
+
+    strings module_names(n);
+    for (size_t i = 0; i < n; i++)
+        module_names[i] = std::filesystem::path(source_files[i]).filename().string();
+
+    start_time_report(options);
+    register_file_reports(module_names);
+    std::vector<std::unique_ptr<ModuleCompiler>> compilers(n);
 
     try {
-        for (int i = 0; i < n; i++)
-            code[i] = preprocessor.process(source_files[i], read_file(source_files[i]));
-        run_clang_on_llvm_ir(stripped, code, args, include_libdua);
+        auto code = preprocess_files(source_files, module_names, options.jobs);
+
+        // The modules are linked together before running, with nothing else
+        InstantiationRegistry registry(module_names);
+        auto program = ProgramInfo::from_code(code);
+
+        for_each_module(n, options.jobs, [&](size_t i) {
+            FileTimeReportScope report_scope(i);
+            compilers[i] = std::make_unique<ModuleCompiler>(module_names[i], code[i], options.include_libdua, &registry,
+                                                            options.whole_program, &program);
+        });
+        for (auto& compiler : compilers)
+            compiler->declare_instances_owned_elsewhere();
+
+        std::vector<const llvm::Module*> modules(n);
+        for (size_t i = 0; i < n; i++)
+            modules[i] = compilers[i]->get_module();
+
+        auto program_name = std::filesystem::path(source_files[0]).stem().string();
+        int exit_code;
+        {
+            PhaseTimer timer("JIT execution");
+            exit_code = run_in_jit(modules, program_name, program_args, options.include_libdua, options.optimization_level,
+                                   options.whole_program);
+        }
+
+        finish_time_report(options);
+        return exit_code;
+    } catch (ReportedError&) {
+        exit(1);
     } catch (std::exception& e) {
         std::cerr << e.what() << '\n';
         exit(1);
@@ -0,0 +1,81 @@
+#include <utils/CompilationCache.hpp>
+#include <utils/CodeGeneration.hpp>
+#include <utils/ErrorReporting.hpp>
+#include <llvm/Support/SHA256.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Config/llvm-config.h>
+
+namespace fs = std::filesystem;
+
+namespace dua
+{
+
+// Identifies the build of the compiler, so that outputs of an older
+//  build are not reused. The size and the modification time of the
+//  executable change whenever the compiler gets rebuilt.
+static const std::string& get_compiler_identity()
+{
+    static const std::string identity = [] {
+        std::string result = "LLVM " LLVM_VERSION_STRING;
+        std::error_code error;
+        fs::path program = get_program_location();
+        auto size = fs::file_size(program, error);
+        if (!error)
+            result += " " + std::to_string(size);
+        auto time = fs::last_write_time(program, error);
+        if (!error)
+            result += " " + std::to_string(time.time_since_epoch().count());
+        return result;
+    }();
+    return identity;
+}
+
+CompilationCache::CompilationCache(const std::string& directory) : directory(directory)
+{
+    std::error_code error;
+    fs::create_directories(this->directory, error);
+    if (error)
+        report_error("Can't create the cache directory " + directory + ": " + error.message());
+}
+
+std::string CompilationCache::compute_key(const std::vector<std::string>& components)
+{
+    // Each component is prefixed with its size to avoid ambiguities
+    std::string data;
+    auto append = [&](const std::string& component) {
+        data += std::to_string(component.size()) + ":" + component;
+    };
+
+    append(get_compiler_identity());
+    for (auto& component : components)
+        append(component);
+
+    auto bytes = llvm::arrayRefFromStringRef(data);
+    auto hash = llvm::SHA256::hash(bytes);
+    return llvm::toHex(hash, true);
+}
+
+bool CompilationCache::fetch(const std::string& key, const std::string& extension, const std::string& output_path) const
+{
+    std::error_code error;
+    auto path = directory / (key + extension);
+    if (!fs::exists(path, error))
+        return false;
+    fs::copy_file(path, output_path, fs::copy_options::overwrite_existing, error);
+    return !error;
+}
+
+void CompilationCache::store(const std::string& key, const std::string& extension, const std::string& output_path) const
+{
+    // Written to a temporary file first, then renamed, so that concurrent
+    //  builds sharing the same cache never see a partially-written file
+    std::error_code error;
+    auto temp = directory / (key + "." + uuid() + ".tmp");
+    fs::copy_file(output_path, temp, fs::copy_options::overwrite_existing, error);
+    if (!error)
+        fs::rename(temp, directory / (key + extension), error);
+    if (error)
+        fs::remove(temp, error);
+}
+
+}
@@ -4,21 +4,35 @@
 namespace dua
 {
 
+// Each thread has its own stream, so that modules that
+//  are compiled concurrently can buffer their diagnostics
+static thread_local std::ostream* current_diagnostics_stream = nullptr;
+
+std::ostream& diagnostics_stream()
+{
+    return current_diagnostics_stream ? *current_diagnostics_stream : std::cerr;
+}
+
+void set_diagnostics_stream(std::ostream* stream)
+{
+    current_diagnostics_stream = stream;
+}
+
 void report_error(const std::string& message)
 {
-    std::cerr << termcolor::red << "Error: " << termcolor::reset << message << '\n';
-    throw std::runtime_error(message);
+    diagnostics_stream() << termcolor::red << "Error: " << termcolor::reset << message << '\n';
+    throw ReportedError(message);
 }
 
 void report_internal_error(const std::string& message)
 {
-    std::cerr << termcolor::red << "Internal Error: " << termcolor::reset << message << '\n';
-    throw std::runtime_error(message);
+    diagnostics_stream() << termcolor::red << "Internal Error: " << termcolor::reset << message << '\n';
+    throw ReportedError(message);
 }
 
 void report_warning(const std::string& message)
 {
-    std::cerr << termcolor::yellow << "Warning: " << termcolor::reset << message << '\n';
+    diagnostics_stream() << termcolor::yellow << "Warning: " << termcolor::reset << message << '\n';
 }
 
 }
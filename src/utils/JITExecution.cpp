@@ -0,0 +1,223 @@
+#include <utils/JITExecution.hpp>
+#include <utils/CodeGeneration.hpp>
+#include <utils/ErrorReporting.hpp>
+#include <cstdio>
+#include <cerrno>
+#include <cstdlib>
+#include <mutex>
+#include <filesystem>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/TargetProcess/TargetExecutionUtils.h>
+#include <llvm/Object/Archive.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+namespace dua
+{
+
+// The helpers of lib/common.c, which wrap C macros and globals that
+//  can't be accessed from Dua. They are linked as absolute symbols,
+//  so that running a program doesn't require a C compiler.
+static void* c_stdin () { return stdin; }
+static void* c_stdout() { return stdout; }
+static void* c_stderr() { return stderr; }
+
+static int c_errno() { return errno; }
+
+static int c_EOF() { return EOF; }
+static int c_ERANGE() { return ERANGE; }
+
+static int c_scan_str(void* stream, char* buffer, int* read_count)
+{
+    return fscanf((FILE*)stream, "%s%n", buffer, read_count);
+}
+
+// The .dua.cleanup functions are registered using atexit from the
+//  .dua.init functions. The calls are redirected here, so that the
+//  cleanup functions run while the JIT-ed code is still alive.
+static std::mutex exit_handlers_mutex;
+static std::vector<void(*)()> exit_handlers;
+
+static int register_exit_handler(void (*handler)())
+{
+    std::lock_guard<std::mutex> lock(exit_handlers_mutex);
+    exit_handlers.push_back(handler);
+    return 0;
+}
+
+// Runs the handlers in the reverse order of their registration,
+//  the same way atexit does. Handlers can register other handlers.
+static void run_exit_handlers()
+{
+    while (true)
+    {
+        void (*handler)();
+        {
+            std::lock_guard<std::mutex> lock(exit_handlers_mutex);
+            if (exit_handlers.empty())
+                return;
+            handler = exit_handlers.back();
+            exit_handlers.pop_back();
+        }
+        handler();
+    }
+}
+
+// The calls of the program to exit are redirected here if an exit function is given
+static void (*program_exit_function)(int) = nullptr;
+
+static void exit_program(int exit_code)
+{
+    run_exit_handlers();
+    program_exit_function(exit_code);
+    // In case the exit function returns
+    std::exit(exit_code);
+}
+
+static void check(llvm::Error error, const std::string& message)
+{
+    if (error)
+        report_error(message + ": " + llvm::toString(std::move(error)));
+}
+
+template <typename T>
+static auto to_symbol(T* pointer)
+{
+    auto flags = llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable;
+#if LLVM_VERSION_MAJOR >= 17
+    return llvm::orc::ExecutorSymbolDef(llvm::orc::ExecutorAddr::fromPtr(pointer), flags);
+#else
+    return llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(pointer), flags);
+#endif
+}
+
+template <typename T>
+static T lookup_function(llvm::orc::LLJIT& jit, const std::string& name)
+{
+    auto symbol = jit.lookup(name);
+    if (!symbol)
+        report_error("Can't find the function " + name + ": " + llvm::toString(symbol.takeError()));
+#if LLVM_VERSION_MAJOR >= 17
+    return symbol->toPtr<T>();
+#else
+    return llvm::jitTargetAddressToFunction<T>(symbol->getAddress());
+#endif
+}
+
+static void define_host_symbols(llvm::orc::LLJIT& jit)
+{
+    auto& dylib = jit.getMainJITDylib();
+
+    llvm::orc::SymbolMap symbols;
+    symbols[jit.mangleAndIntern("c_stdin")] = to_symbol(&c_stdin);
+    symbols[jit.mangleAndIntern("c_stdout")] = to_symbol(&c_stdout);
+    symbols[jit.mangleAndIntern("c_stderr")] = to_symbol(&c_stderr);
+    symbols[jit.mangleAndIntern("c_errno")] = to_symbol(&c_errno);
+    symbols[jit.mangleAndIntern("c_EOF")] = to_symbol(&c_EOF);
+    symbols[jit.mangleAndIntern("c_ERANGE")] = to_symbol(&c_ERANGE);
+    symbols[jit.mangleAndIntern("c_scan_str")] = to_symbol(&c_scan_str);
+    symbols[jit.mangleAndIntern("atexit")] = to_symbol(&register_exit_handler);
+    if (program_exit_function != nullptr)
+        symbols[jit.mangleAndIntern("exit")] = to_symbol(&exit_program);
+    check(dylib.define(llvm::orc::absoluteSymbols(std::move(symbols))), "Can't define the host symbols");
+
+    // The rest of the C library (printf, malloc, exit, ...)
+    auto process_symbols = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        jit.getDataLayout().getGlobalPrefix());
+    if (!process_symbols)
+        report_error("Can't load the symbols of the process: " + llvm::toString(process_symbols.takeError()));
+    dylib.addGenerator(std::move(*process_symbols));
+}
+
+// Makes the objects of libdua.a available to the JIT-ed code, and returns
+//  the names of their .dua.init functions. The JIT only runs the global
+//  constructors of IR modules, so the initializers of the library (e.g.
+//  the construction of the global streams) have to be called explicitly.
+static std::vector<std::string> load_libdua(llvm::orc::LLJIT& jit)
+{
+    auto program_path = std::filesystem::weakly_canonical(get_program_location());
+    auto path = (program_path.parent_path() / "libdua.a").string();
+
+    auto generator = llvm::orc::StaticLibraryDefinitionGenerator::Load(jit.getObjLinkingLayer(), path.c_str());
+    if (!generator)
+        report_error("Can't load the library " + path + ": " + llvm::toString(generator.takeError()));
+    jit.getMainJITDylib().addGenerator(std::move(*generator));
+
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer)
+        report_error("Can't read the library " + path + ": " + buffer.getError().message());
+
+    auto archive = llvm::object::Archive::create((*buffer)->getMemBufferRef());
+    if (!archive)
+        report_error("Can't read the library " + path + ": " + llvm::toString(archive.takeError()));
+
+    std::vector<std::string> init_functions;
+    for (auto& symbol : (*archive)->symbols()) {
+        auto name = symbol.getName();
+        if (name.startswith(".dua.init."))
+            init_functions.push_back(name.str());
+    }
+
+    return init_functions;
+}
+
+int run_in_jit(const std::vector<const llvm::Module*>& modules, const std::string& program_name,
+               const std::vector<std::string>& program_args, bool include_libdua, OptimizationLevel level,
+               bool whole_program, const std::function<void()>& before_main, void (*exit_function)(int))
+{
+    initialize_native_backend();
+    program_exit_function = exit_function;
+
+    auto jit = llvm::orc::LLJITBuilder().create();
+    if (!jit)
+        report_error("Can't create the JIT: " + llvm::toString(jit.takeError()));
+
+    define_host_symbols(**jit);
+
+    // The handlers still registered when the program calls exit
+    //  run along with the ones of the compiler itself.
+    static std::once_flag exit_hook;
+    std::call_once(exit_hook, [] { std::atexit(run_exit_handlers); });
+
+    // The modules are linked into one module first
+    auto context = std::make_unique<llvm::LLVMContext>();
+    auto program = link_modules(modules, program_name, *context);
+    if (whole_program)
+        internalize_module(*program);
+
+    if (level != OptimizationLevel::O0 || whole_program) {
+        auto target_machine = create_target_machine("", level);
+        optimize_module(*program, *target_machine, level, false, whole_program);
+    }
+    program->setTargetTriple((*jit)->getTargetTriple().str());
+    program->setDataLayout((*jit)->getDataLayout());
+
+    std::vector<std::string> libdua_init_functions;
+    if (include_libdua)
+        libdua_init_functions = load_libdua(**jit);
+
+    llvm::orc::ThreadSafeModule module(std::move(program), std::move(context));
+    check((*jit)->addIRModule(std::move(module)), "Can't add the program to the JIT");
+
+    for (auto& name : libdua_init_functions)
+        lookup_function<void(*)()>(**jit, name)();
+
+    // Runs the global constructors, which include the .dua.init functions
+    check((*jit)->initialize((*jit)->getMainJITDylib()), "Can't initialize the program");
+
+    // Looking main up materializes the program
+    auto main_function = lookup_function<int(*)(int, char*[])>(**jit, "main");
+    if (before_main)
+        before_main();
+    int exit_code = llvm::orc::runAsMain(main_function, program_args, llvm::StringRef(program_name));
+
+    run_exit_handlers();
+    check((*jit)->deinitialize((*jit)->getMainJITDylib()), "Can't deinitialize the program");
+
+    std::fflush(nullptr);
+
+    return exit_code;
+}
+
+}
@@ -0,0 +1,210 @@
+#include <utils/NativeBackend.hpp>
+#include <utils/ErrorReporting.hpp>
+#include <mutex>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/IR/PassInstrumentation.h>
+#include <llvm/IR/PassTimingInfo.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Transforms/IPO/Internalize.h>
+
+namespace dua
+{
+
+void initialize_native_backend()
+{
+    static std::once_flag initialized;
+    std::call_once(initialized, [] {
+        llvm::InitializeAllTargetInfos();
+        llvm::InitializeAllTargets();
+        llvm::InitializeAllTargetMCs();
+        llvm::InitializeAllAsmParsers();
+        llvm::InitializeAllAsmPrinters();
+    });
+}
+
+static llvm::CodeGenOpt::Level get_codegen_level(OptimizationLevel level)
+{
+    switch (level)
+    {
+        case OptimizationLevel::O0: return llvm::CodeGenOpt::None;
+        case OptimizationLevel::O1: return llvm::CodeGenOpt::Less;
+        case OptimizationLevel::O3: return llvm::CodeGenOpt::Aggressive;
+        default:                    return llvm::CodeGenOpt::Default;
+    }
+}
+
+static llvm::OptimizationLevel get_pipeline_level(OptimizationLevel level)
+{
+    switch (level)
+    {
+        case OptimizationLevel::O0: return llvm::OptimizationLevel::O0;
+        case OptimizationLevel::O1: return llvm::OptimizationLevel::O1;
+        case OptimizationLevel::O2: return llvm::OptimizationLevel::O2;
+        case OptimizationLevel::O3: return llvm::OptimizationLevel::O3;
+        case OptimizationLevel::Os: return llvm::OptimizationLevel::Os;
+        case OptimizationLevel::Oz: return llvm::OptimizationLevel::Oz;
+    }
+    return llvm::OptimizationLevel::O0;
+}
+
+// The passes, and the backend, make decisions based on the target
+static void set_target(llvm::Module& module, llvm::TargetMachine& target_machine)
+{
+    module.setTargetTriple(target_machine.getTargetTriple().str());
+    module.setDataLayout(target_machine.createDataLayout());
+}
+
+std::unique_ptr<llvm::TargetMachine> create_target_machine(const std::string& target_triple, OptimizationLevel level)
+{
+    auto triple = target_triple.empty() ? llvm::sys::getDefaultTargetTriple() : target_triple;
+
+    std::string error;
+    auto target = llvm::TargetRegistry::lookupTarget(triple, error);
+    if (target == nullptr)
+        report_error("Unsupported target " + triple + ": " + error);
+
+    llvm::TargetOptions options;
+    // Position independent code, to be linkable
+    //  into PIEs, which is the default for clang.
+    auto target_machine = target->createTargetMachine(triple, "generic", "", options,
+                                                      llvm::Reloc::PIC_, {}, get_codegen_level(level));
+    if (target_machine == nullptr)
+        report_error("Can't create a target machine for the target " + triple);
+
+    return std::unique_ptr<llvm::TargetMachine>(target_machine);
+}
+
+void optimize_module(llvm::Module& module, llvm::TargetMachine& target_machine, OptimizationLevel level, bool print_timings, bool whole_program)
+{
+    if (level == OptimizationLevel::O0 && !print_timings && !whole_program)
+        return;
+
+    set_target(module, target_machine);
+
+    llvm::LoopAnalysisManager loop_analysis_manager;
+    llvm::FunctionAnalysisManager function_analysis_manager;
+    llvm::CGSCCAnalysisManager cgscc_analysis_manager;
+    llvm::ModuleAnalysisManager module_analysis_manager;
+
+    // Modules can be optimized concurrently, thus, each
+    //  module gets its own timers, and its own report
+    llvm::PassInstrumentationCallbacks instrumentation;
+    llvm::TimePassesHandler timings(print_timings);
+    std::string report;
+    llvm::raw_string_ostream report_stream(report);
+    timings.setOutStream(report_stream);
+    timings.registerCallbacks(instrumentation);
+
+    llvm::PassBuilder pass_builder(&target_machine, llvm::PipelineTuningOptions(), {}, &instrumentation);
+    pass_builder.registerModuleAnalyses(module_analysis_manager);
+    pass_builder.registerCGSCCAnalyses(cgscc_analysis_manager);
+    pass_builder.registerFunctionAnalyses(function_analysis_manager);
+    pass_builder.registerLoopAnalyses(loop_analysis_manager);
+    pass_builder.crossRegisterProxies(loop_analysis_manager, function_analysis_manager,
+                                      cgscc_analysis_manager, module_analysis_manager);
+
+    llvm::ModulePassManager pass_manager;
+    if (whole_program)
+        pass_manager = pass_builder.buildLTODefaultPipeline(get_pipeline_level(level), nullptr);
+    else if (level == OptimizationLevel::O0)
+        pass_manager = pass_builder.buildO0DefaultPipeline(llvm::OptimizationLevel::O0);
+    else
+        pass_manager = pass_builder.buildPerModuleDefaultPipeline(get_pipeline_level(level));
+
+    pass_manager.run(module, module_analysis_manager);
+
+    if (print_timings) {
+        timings.print();
+        report_stream.flush();
+        diagnostics_stream() << "Pipeline timings of the module " << module.getName().str() << ":\n" << report;
+    }
+}
+
+void emit_module(llvm::Module& module, llvm::TargetMachine& target_machine, OutputKind kind, const std::string& path)
+{
+    set_target(module, target_machine);
+
+    std::error_code error;
+    auto flags = (kind == OutputKind::LLVM_IR || kind == OutputKind::ASSEMBLY) ? llvm::sys::fs::OF_Text : llvm::sys::fs::OF_None;
+    llvm::raw_fd_ostream stream(path, error, flags);
+    if (error)
+        report_error("Can't open the file " + path + ": " + error.message());
+
+    switch (kind)
+    {
+        case OutputKind::LLVM_IR:
+            module.print(stream, nullptr);
+            break;
+        case OutputKind::BITCODE:
+            llvm::WriteBitcodeToFile(module, stream);
+            break;
+        case OutputKind::ASSEMBLY:
+        case OutputKind::OBJECT: {
+            auto file_type = kind == OutputKind::ASSEMBLY ? llvm::CGFT_AssemblyFile : llvm::CGFT_ObjectFile;
+            llvm::legacy::PassManager pass_manager;
+            if (target_machine.addPassesToEmitFile(pass_manager, stream, nullptr, file_type))
+                report_error("The target " + module.getTargetTriple() + " can't emit this type of files");
+            pass_manager.run(module);
+            break;
+        }
+    }
+
+    stream.flush();
+}
+
+std::string get_output_extension(OutputKind kind)
+{
+    switch (kind)
+    {
+        case OutputKind::LLVM_IR:  return ".ll";
+        case OutputKind::BITCODE:  return ".bc";
+        case OutputKind::ASSEMBLY: return ".s";
+        case OutputKind::OBJECT:   return ".o";
+    }
+    return "";
+}
+
+std::unique_ptr<llvm::Module> copy_module_to_context(const llvm::Module& module, llvm::LLVMContext& context)
+{
+    llvm::SmallVector<char, 0> buffer;
+    llvm::raw_svector_ostream stream(buffer);
+    llvm::WriteBitcodeToFile(module, stream);
+
+    llvm::MemoryBufferRef bitcode(llvm::StringRef(buffer.data(), buffer.size()), module.getModuleIdentifier());
+    auto result = llvm::parseBitcodeFile(bitcode, context);
+    if (!result)
+        report_error("Can't copy the module " + module.getModuleIdentifier() + ": " + llvm::toString(result.takeError()));
+
+    return std::move(*result);
+}
+
+std::unique_ptr<llvm::Module> link_modules(const std::vector<const llvm::Module*>& modules, const std::string& name,
+                                           llvm::LLVMContext& context)
+{
+    auto result = std::make_unique<llvm::Module>(name, context);
+    for (auto module : modules) {
+        if (llvm::Linker::linkModules(*result, copy_module_to_context(*module, context)))
+            report_error("Can't link the module " + module->getModuleIdentifier());
+    }
+    return result;
+}
+
+void internalize_module(llvm::Module& module)
+{
+    llvm::internalizeModule(module, [](const llvm::GlobalValue& value) {
+        auto name = value.getName();
+        return name == "main" || name.startswith(".dua.init") || name.startswith(".dua.cleanup")
+            || name.endswith(".vtable.instance");
+    });
+}
+
+}
@@ -9,17 +9,29 @@ namespace dua
 
 std::string read_file(const std::string& name)
 {
-    std::string result;
-    std::ifstream stream(name);
-
-    if (stream)
-    {
-        std::string temp;
-        while (std::getline(stream, temp))
-            result += temp + '\n';
-    } else {
+    std::ifstream stream(name, std::ios::binary);
+    if (!stream)
         report_error("Couldn't read the contents of the file at " + name);
-    }
+
+    // Read at once, instead of line by line
+    stream.seekg(0, std::ios::end);
+    std::string result(stream.tellg(), '\0');
+    stream.seekg(0, std::ios::beg);
+    stream.read(result.data(), result.size());
+
+    if (result.find("\r\n") != std::string::npos)
+        return normalize_line_endings(result);
+
+    return result;
+}
+
+std::string normalize_line_endings(std::string_view text)
+{
+    std::string result;
+    result.reserve(text.size());
+    for (size_t i = 0; i < text.size(); i++)
+        if (text[i] != '\r' || i + 1 == text.size() || text[i + 1] != '\n')
+            result.push_back(text[i]);
     return result;
 }
 
@@ -0,0 +1,240 @@
+#include <utils/TimeReport.hpp>
+#include <utils/ErrorReporting.hpp>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <iomanip>
+#include <algorithm>
+#include <ctime>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/FileSystem.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+namespace dua
+{
+
+static std::atomic<bool> time_report_enabled = false;
+static std::atomic<bool> time_trace_enabled = false;
+
+static std::mutex reports_mutex;
+// Indexed by the files, which are registered before they're compiled,
+//  so that files with the same name still get separate reports.
+static std::vector<std::unique_ptr<TimeReport>> file_reports;
+static TimeReport build_report { "Build" };
+
+// nullptr means the build report
+static thread_local TimeReport* current_report = nullptr;
+
+static TimeReport* get_current_report()
+{
+    if (!time_report_enabled)
+        return nullptr;
+    return current_report ? current_report : &build_report;
+}
+
+static double get_cpu_time()
+{
+#ifdef _WIN32
+    return double(std::clock()) / CLOCKS_PER_SEC;
+#else
+    timespec thread_time {};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &thread_time);
+    // The subprocesses that have terminated, such as clang
+    rusage children {};
+    getrusage(RUSAGE_CHILDREN, &children);
+    return thread_time.tv_sec + thread_time.tv_nsec / 1e9
+         + children.ru_utime.tv_sec + children.ru_utime.tv_usec / 1e6
+         + children.ru_stime.tv_sec + children.ru_stime.tv_usec / 1e6;
+#endif
+}
+
+void TimeReport::add_time(const std::string& phase, PhaseTime time)
+{
+    for (auto& [name, total] : phases) {
+        if (name == phase) {
+            total.wall += time.wall;
+            total.cpu += time.cpu;
+            return;
+        }
+    }
+    phases.emplace_back(phase, time);
+}
+
+void TimeReport::add_to_counter(const std::string& counter, size_t n)
+{
+    for (auto& [name, total] : counters) {
+        if (name == counter) {
+            total += n;
+            return;
+        }
+    }
+    counters.emplace_back(counter, n);
+}
+
+void TimeReport::merge(const TimeReport& other)
+{
+    for (auto& [phase, time] : other.phases)
+        add_time(phase, time);
+    for (auto& [counter, n] : other.counters)
+        add_to_counter(counter, n);
+}
+
+void TimeReport::print(std::ostream& stream) const
+{
+    std::string line(70, '-');
+    stream << line << '\n' << "Dua time report: " << name << '\n' << line << '\n';
+
+    auto flags = stream.flags();
+    stream << std::fixed << std::setprecision(4);
+    stream << "  " << std::left << std::setw(36) << "Phase" << std::right
+           << std::setw(14) << "Wall (s)" << std::setw(14) << "CPU (s)" << '\n';
+    for (auto& [phase, time] : phases)
+        stream << "  " << std::left << std::setw(36) << phase << std::right
+               << std::setw(14) << time.wall << std::setw(14) << time.cpu << '\n';
+
+    if (!counters.empty()) {
+        stream << '\n' << "  " << std::left << std::setw(36) << "Counter" << std::right << std::setw(14) << "Value" << '\n';
+        for (auto& [counter, n] : counters)
+            stream << "  " << std::left << std::setw(36) << counter << std::right << std::setw(14) << n << '\n';
+    }
+    stream << '\n';
+    stream.flags(flags);
+}
+
+void enable_time_report() {
+    time_report_enabled = true;
+}
+
+void enable_time_trace()
+{
+    if (!time_trace_enabled.exchange(true)) {
+        // The calling thread owns the trace, and the
+        //  traces of the worker threads are merged to it.
+        llvm::timeTraceProfilerInitialize(0, "Dua");
+    }
+}
+
+bool is_time_report_enabled() {
+    return time_report_enabled;
+}
+
+bool is_time_trace_enabled() {
+    return time_trace_enabled;
+}
+
+void register_file_reports(const std::vector<std::string>& files)
+{
+    if (!time_report_enabled)
+        return;
+
+    std::lock_guard<std::mutex> lock(reports_mutex);
+    file_reports.clear();
+    for (auto& file : files) {
+        file_reports.push_back(std::make_unique<TimeReport>());
+        file_reports.back()->name = file;
+    }
+}
+
+FileTimeReportScope::FileTimeReportScope(size_t file)
+{
+    if (time_trace_enabled && llvm::getTimeTraceProfilerInstance() == nullptr) {
+        llvm::timeTraceProfilerInitialize(0, "Dua");
+        finish_trace_thread = true;
+    }
+
+    if (!time_report_enabled)
+        return;
+
+    TimeReport* report = nullptr;
+    {
+        // An unregistered file is recorded in the build report
+        std::lock_guard<std::mutex> lock(reports_mutex);
+        if (file < file_reports.size())
+            report = file_reports[file].get();
+    }
+
+    previous = current_report;
+    current_report = report;
+    active = true;
+}
+
+FileTimeReportScope::~FileTimeReportScope()
+{
+    if (active)
+        current_report = previous;
+    if (finish_trace_thread)
+        llvm::timeTraceProfilerFinishThread();
+}
+
+PhaseTimer::PhaseTimer(const char* phase) : phase(phase)
+{
+    report = get_current_report();
+    if (report != nullptr)
+    {
+        auto& active = report->active_phases;
+        if (std::find(active.begin(), active.end(), phase) != active.end()) {
+            // Already being timed by an outer timer
+            report = nullptr;
+        } else {
+            active.push_back(phase);
+            start_wall = std::chrono::steady_clock::now();
+            start_cpu = get_cpu_time();
+        }
+    }
+
+    if (time_trace_enabled && llvm::getTimeTraceProfilerInstance() != nullptr) {
+        auto file = current_report ? current_report->name : "";
+        llvm::timeTraceProfilerBegin(phase, file);
+        traced = true;
+    }
+}
+
+PhaseTimer::~PhaseTimer()
+{
+    if (traced)
+        llvm::timeTraceProfilerEnd();
+
+    if (report == nullptr)
+        return;
+
+    std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start_wall;
+    report->add_time(phase, { wall.count(), get_cpu_time() - start_cpu });
+    report->active_phases.erase(std::find(report->active_phases.begin(), report->active_phases.end(), phase));
+}
+
+void add_to_counter(const char* counter, size_t n)
+{
+    if (auto report = get_current_report(); report != nullptr)
+        report->add_to_counter(counter, n);
+}
+
+void print_time_reports(std::ostream& stream)
+{
+    std::lock_guard<std::mutex> lock(reports_mutex);
+
+    TimeReport total { "Total (" + std::to_string(file_reports.size()) + " files)" };
+    for (auto& report : file_reports) {
+        report->print(stream);
+        total.merge(*report);
+    }
+    total.merge(build_report);
+
+    total.print(stream);
+}
+
+void write_time_trace(const std::string& path)
+{
+    std::error_code error;
+    llvm::raw_fd_ostream stream(path, error, llvm::sys::fs::OF_Text);
+    if (error)
+        report_error("Can't open the file " + path + ": " + error.message());
+    llvm::timeTraceProfilerWrite(stream);
+    llvm::timeTraceProfilerCleanup();
+    time_trace_enabled = false;
+}
+
+}
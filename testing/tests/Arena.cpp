@@ -0,0 +1,64 @@
+#include <utils/Arena.hpp>
+#include <ModuleCompiler.hpp>
+#include <types/IntegerTypes.hpp>
+#include <types/PointerType.hpp>
+#include <gtest/gtest.h>
+
+namespace dua
+{
+
+struct Tracked
+{
+    std::vector<int>& destroyed;
+    int id;
+    Tracked(std::vector<int>& destroyed, int id) : destroyed(destroyed), id(id) {}
+    ~Tracked() { destroyed.push_back(id); }
+};
+
+TEST(arena, objects_are_destroyed_with_the_arena_in_reverse_order) {
+    std::vector<int> destroyed;
+    {
+        Arena arena;
+        for (int i = 0; i < 3; i++)
+            arena.create<Tracked>(destroyed, i);
+        ASSERT_TRUE(destroyed.empty());
+    }
+    ASSERT_EQ(destroyed, std::vector<int>({ 2, 1, 0 }));
+}
+
+TEST(arena, objects_stay_valid_as_blocks_are_added) {
+    Arena arena;
+    std::vector<std::pair<size_t*, size_t>> objects;
+    for (size_t i = 0; i < 100000; i++)
+        objects.emplace_back(arena.create<size_t>(i), i);
+    for (auto& [object, value] : objects)
+        ASSERT_EQ(*object, value);
+    ASSERT_GE(arena.get_allocated_size(), 100000 * sizeof(size_t));
+}
+
+TEST(arena, allocations_are_aligned) {
+    Arena arena;
+    arena.create<char>('a');
+    auto value = arena.create<double>(1.5);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(value) % alignof(double), 0);
+    arena.create<char>('b');
+    auto aligned = arena.allocate(32, alignof(std::max_align_t));
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(aligned) % alignof(std::max_align_t), 0);
+}
+
+TEST(arena, large_objects_dont_waste_the_current_block) {
+    Arena arena;
+    auto first = arena.create<char>('a');
+    arena.allocate(16 * 1024 * 1024, 1);
+    auto second = arena.create<char>('b');
+    ASSERT_EQ(second, first + 1);
+}
+
+TEST(arena, types_live_as_long_as_the_compiler) {
+    ModuleCompiler compiler("arena", "int f() { return 1; }", false);
+    auto pointer = compiler.create_type<PointerType>(compiler.create_type<I32Type>());
+    // Still valid after the code generation
+    ASSERT_EQ(pointer->to_string(), "i32*");
+}
+
+}
@@ -0,0 +1,89 @@
+#include <utils/CompilationCache.hpp>
+#include <utils/CodeGeneration.hpp>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+
+namespace dua
+{
+
+namespace fs = std::filesystem;
+
+static std::string read_text(const fs::path& path)
+{
+    std::ifstream stream(path, std::ios::binary);
+    return { std::istreambuf_iterator<char>(stream), {} };
+}
+
+// Replaces the cached outputs with a marker, which a build only
+//  outputs if it takes the output from the cache
+static void mark_cached_outputs(const fs::path& cache)
+{
+    for (auto& entry : fs::directory_iterator(cache))
+        std::ofstream(entry.path(), std::ios::binary) << "cached";
+}
+
+struct CacheTest : testing::Test
+{
+    fs::path directory = fs::temp_directory_path() / uuid();
+    fs::path cache = directory / "cache";
+    std::string output = (directory / "a.ll").string();
+    CompilationOptions options;
+
+    void SetUp() override {
+        fs::create_directory(directory);
+        options.include_libdua = false;
+        options.cache_directory = cache.string();
+    }
+
+    void TearDown() override {
+        fs::remove_all(directory);
+    }
+
+    // Returns whether the output was taken from the cache
+    bool build(const std::string& code)
+    {
+        emit_modules({ "a.dua" }, { code }, { output }, OutputKind::LLVM_IR, options);
+        auto result = read_text(output);
+        mark_cached_outputs(cache);
+        return result == "cached";
+    }
+};
+
+TEST_F(CacheTest, hit_when_nothing_changes) {
+    ASSERT_FALSE(build("int main() { return 0; }"));
+    ASSERT_TRUE(build("int main() { return 0; }"));
+}
+
+TEST_F(CacheTest, miss_when_the_source_changes) {
+    ASSERT_FALSE(build("int main() { return 0; }"));
+    ASSERT_FALSE(build("int main() { return 1; }"));
+    ASSERT_TRUE(build("int main() { return 1; }"));
+    // The outputs of the previous versions are kept
+    ASSERT_TRUE(build("int main() { return 0; }"));
+}
+
+TEST_F(CacheTest, miss_when_the_flags_change) {
+    ASSERT_FALSE(build("int main() { return 0; }"));
+    options.optimization_level = OptimizationLevel::O2;
+    ASSERT_FALSE(build("int main() { return 0; }"));
+    options.has_all_dua_files = true;
+    ASSERT_FALSE(build("int main() { return 0; }"));
+    ASSERT_TRUE(build("int main() { return 0; }"));
+}
+
+TEST_F(CacheTest, miss_when_the_output_kind_changes) {
+    ASSERT_FALSE(build("int main() { return 0; }"));
+    auto object = (directory / "a.o").string();
+    emit_modules({ "a.dua" }, { "int main() { return 0; }" }, { object }, OutputKind::OBJECT, options);
+    ASSERT_NE(read_text(object), "cached");
+}
+
+TEST(compilation_cache, keys_separate_the_components) {
+    auto key = CompilationCache::compute_key({ "ab", "c" });
+    ASSERT_EQ(key, CompilationCache::compute_key({ "ab", "c" }));
+    ASSERT_NE(key, CompilationCache::compute_key({ "a", "bc" }));
+    ASSERT_NE(key, CompilationCache::compute_key({ "abc" }));
+}
+
+}
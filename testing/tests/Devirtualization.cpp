@@ -0,0 +1,116 @@
+#include "FileTestCasesRunner.hpp"
+#include <ModuleCompiler.hpp>
+#include <resolution/ProgramInfo.hpp>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/InstrTypes.h>
+
+namespace dua
+{
+
+TEST(devirtualization, devirtualization) {
+    FileTestCasesRunner("devirtualization.dua").run();
+}
+
+TEST(devirtualization, whole_program) {
+    FileTestCasesRunner("devirtualization.dua", {}, true).run();
+}
+
+static const std::string classes = R"(
+class X { int value() { return 1; } }
+class Y : X { int value() { return 2; } }
+class W : Y { int value() { return 3; } }
+class Z : X { }
+class H { Y y; }
+
+int call_field(H& h) { return h.y.value(); }
+int call_leaf(Z& z) { return z.value(); }
+int call_parent(X& x) { return x.value(); }
+
+int main() { return 0; }
+)";
+
+struct CallsSummary
+{
+    std::vector<std::string> direct;
+    size_t indirect = 0;
+    size_t indirect_with_callees = 0;
+};
+
+// Summarizes the calls made in the function that has the given name in its full name
+static CallsSummary summarize_calls(llvm::Module& module, const std::string& name)
+{
+    CallsSummary summary;
+    for (auto& function : module) {
+        if (function.isDeclaration() || function.getName().str().find(name) == std::string::npos)
+            continue;
+        for (auto& block : function)
+            for (auto& instruction : block) {
+                auto call = llvm::dyn_cast<llvm::CallBase>(&instruction);
+                if (call == nullptr || call->isInlineAsm())
+                    continue;
+                if (auto callee = call->getCalledFunction(); callee != nullptr) {
+                    if (!callee->isIntrinsic())
+                        summary.direct.push_back(callee->getName().str());
+                } else {
+                    summary.indirect++;
+                    if (call->getMetadata(llvm::LLVMContext::MD_callees) != nullptr)
+                        summary.indirect_with_callees++;
+                }
+            }
+    }
+    return summary;
+}
+
+TEST(devirtualization, by_value_field_is_called_directly) {
+    auto program = ProgramInfo::from_code({ classes });
+    ModuleCompiler compiler("field", classes, false, nullptr, false, &program);
+    auto calls = summarize_calls(*compiler.get_module(), "call_field");
+    // Y has a subclass, so only the exact type of the field allows the direct call
+    ASSERT_EQ(calls.indirect, 0);
+    ASSERT_EQ(calls.direct.size(), 1);
+    ASSERT_NE(calls.direct[0].find("Y.value"), std::string::npos);
+}
+
+TEST(devirtualization, leaf_class_is_called_directly) {
+    auto program = ProgramInfo::from_code({ classes });
+    ModuleCompiler compiler("leaf", classes, false, nullptr, false, &program);
+    auto calls = summarize_calls(*compiler.get_module(), "call_leaf");
+    ASSERT_EQ(calls.indirect, 0);
+    ASSERT_EQ(calls.direct.size(), 1);
+    // Z inherits the method of X
+    ASSERT_NE(calls.direct[0].find("X.value"), std::string::npos);
+}
+
+TEST(devirtualization, virtual_call_lists_its_callees) {
+    auto program = ProgramInfo::from_code({ classes });
+    ModuleCompiler compiler("callees", classes, false, nullptr, false, &program);
+    auto calls = summarize_calls(*compiler.get_module(), "call_parent");
+    ASSERT_EQ(calls.indirect, 1);
+    ASSERT_EQ(calls.indirect_with_callees, 1);
+}
+
+TEST(devirtualization, set_vtable_in_another_file) {
+    // The other file may change the vtable of any object passed to it
+    auto program = ProgramInfo::from_code({ classes, "void f(X& x) { _set_vtable(x, Y); }" });
+    ASSERT_TRUE(program.uses_set_vtable);
+    ASSERT_FALSE(program.is_single_module);
+
+    ModuleCompiler compiler("other_file", classes, false, nullptr, false, &program);
+    for (auto name : { "call_field", "call_leaf", "call_parent" }) {
+        auto calls = summarize_calls(*compiler.get_module(), name);
+        ASSERT_EQ(calls.indirect, 1) << name;
+        ASSERT_EQ(calls.indirect_with_callees, 0) << name;
+    }
+}
+
+TEST(devirtualization, separate_compilation) {
+    // Compiled without knowing the rest of the program (e.g. using -c)
+    ModuleCompiler compiler("separate", classes, false, nullptr);
+    for (auto name : { "call_field", "call_leaf", "call_parent" }) {
+        auto calls = summarize_calls(*compiler.get_module(), name);
+        ASSERT_EQ(calls.indirect, 1) << name;
+        ASSERT_EQ(calls.indirect_with_callees, 0) << name;
+    }
+}
+
+}
@@ -6,11 +6,378 @@
 #include <utils/CodeGeneration.hpp>
 #include <utils/ProgramExecution.hpp>
 #include <filesystem>
+#include <cstdlib>
+#include <cerrno>
+#include <sstream>
+#include <thread>
+#include <chrono>
 #include <gtest/gtest.h>
 
+#ifndef _WIN32
+#include <ModuleCompiler.hpp>
+#include <resolution/ProgramInfo.hpp>
+#include <utils/JITExecution.hpp>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#endif
+
 namespace dua
 {
 
+struct TestCase
+{
+    std::string name;
+    std::string encoded_name;
+    // Empty if the preprocessor threw
+    std::string preprocessed;
+    std::string expected_output;
+    bool expected_output_is_empty = true;
+    std::string expected_exit_code_str;
+    std::string expected_time_limit_str;
+    // In milliseconds. -1 means no limit
+    long long time_limit = -1;
+    bool exceeds_time_limit = false;
+    bool should_panic = false;
+};
+
+// The outcome of compiling and executing a test case
+struct TestCaseResult
+{
+    bool compilation_threw = false;
+    bool timed_out = false;
+    // Set if the program couldn't be executed
+    std::string execution_error;
+    ProgramExecution execution;
+};
+
+// Compiles the case into an executable using clang, and runs it
+static TestCaseResult run_with_clang(const TestCase& test, const std::vector<std::string>& args, bool whole_program)
+{
+    TestCaseResult result;
+
+    // Windows will complain if the extension is not .exe,
+    //  and it doesn't hurt when run on Unix-based systems.
+    auto exe_name = test.encoded_name + ".exe";
+
+    std::vector<std::string> n = { test.encoded_name };
+    std::vector<std::string> c = { test.preprocessed };
+    std::vector<std::string> a = { "-o", exe_name, PROJECT_ROOT_DIR + "/lib/common.c" };
+
+    try {
+        if (whole_program) {
+            // The case is emitted in-process, and clang only links it
+            CompilationOptions options;
+            options.include_libdua = false;
+            options.whole_program = true;
+            auto object_name = test.encoded_name + ".o";
+            emit_whole_program(n, c, object_name, OutputKind::OBJECT, options);
+            run_clang(a + object_name, false);
+            std::filesystem::remove(object_name);
+        } else {
+            run_clang_on_llvm_ir(n, c, a, false, false);
+        }
+    } catch (...) {
+        result.compilation_threw = true;
+        return result;
+    }
+
+    if (test.should_panic) {
+        std::filesystem::remove(exe_name);
+        return result;
+    }
+
+    try {
+        result.execution = execute_program(exe_name, args, test.time_limit);
+    } catch (TLEException& e) {
+        result.timed_out = true;
+    } catch (std::exception& e) {
+        result.execution_error = e.what();
+    }
+
+    std::filesystem::remove(exe_name);
+
+    return result;
+}
+
+#ifndef _WIN32
+
+// Sent by the child process over the status pipe
+const char COMPILED = 'C';
+// Right before main is called, once the JIT has generated the code
+const char STARTED = 'S';
+const char COMPILATION_THREW = 'P';
+const char EXECUTION_FAILED = 'X';
+
+// Matches the way execute_program captures the output. Each
+//  line ends with a \n, and the \r before the \n is removed.
+static std::string normalize_output(const std::string& output)
+{
+    std::istringstream stream(output);
+    std::string result, line;
+    while (std::getline(stream, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        result += line + '\n';
+    }
+    return result;
+}
+
+static void write_status(int fd, char status)
+{
+    while (write(fd, &status, 1) < 0 && errno == EINTR);
+}
+
+// Ends the child, including when the test program calls exit. _exit is used
+//  to skip the destructors and the atexit handlers of the parent (e.g. the
+//  ones of gtest), which the child inherits.
+[[noreturn]] static void exit_child(int exit_code)
+{
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+    _exit(exit_code);
+}
+
+// Runs in the forked child, with stdout and stderr redirected to the pipes
+[[noreturn]] static void run_child(const TestCase& test, const std::vector<std::string>& args, bool whole_program,
+                                   int status_fd)
+{
+    // The test case is the whole program
+    auto program = ProgramInfo::from_code({ test.preprocessed });
+    std::unique_ptr<ModuleCompiler> compiler;
+    try {
+        compiler = std::make_unique<ModuleCompiler>(test.encoded_name, test.preprocessed, false, nullptr, whole_program, &program);
+    } catch (...) {
+        write_status(status_fd, COMPILATION_THREW);
+        _exit(0);
+    }
+
+    write_status(status_fd, COMPILED);
+
+    if (test.should_panic)
+        _exit(0);
+
+    // The time limit starts with main, so that the code generation of the
+    //  JIT isn't counted, just like the compilation by clang isn't counted
+    //  by the clang runner. The parent kills the child once the time limit
+    //  is exceeded. The alarm is a fallback, in case the parent falls behind.
+    auto start = [&] {
+        if (test.time_limit > 0) {
+            itimerval timer {};
+            timer.it_value.tv_sec = test.time_limit / 1000;
+            timer.it_value.tv_usec = (test.time_limit % 1000) * 1000;
+            setitimer(ITIMER_REAL, &timer, nullptr);
+        }
+        write_status(status_fd, STARTED);
+    };
+
+    int exit_code;
+    try {
+        exit_code = run_in_jit({ compiler->get_module() }, test.encoded_name, args, false, OptimizationLevel::O0,
+                               whole_program, start, exit_child);
+    } catch (std::exception& e) {
+        write_status(status_fd, EXECUTION_FAILED);
+        std::cerr << e.what();
+        exit_child(1);
+    }
+
+    exit_child(exit_code);
+}
+
+// The time the child of a case has to compile the case and start running main,
+//  after which it gets killed, in case the compilation never finishes
+const auto SETUP_TIME_LIMIT = std::chrono::seconds(60);
+
+// Compiles and runs each case using the JIT in a forked child process, with up
+//  to the given number of children at a time. The outputs of the child are
+//  captured through pipes, and it gets killed once its time limit is exceeded.
+//  The time limit only covers the execution of main, not the compilation,
+//  which has the generous SETUP_TIME_LIMIT instead.
+static std::vector<TestCaseResult> run_in_child_processes(const std::vector<TestCase>& cases,
+                                                          const std::vector<std::string>& args,
+                                                          bool whole_program, size_t jobs)
+{
+    using clock = std::chrono::steady_clock;
+
+    struct Child
+    {
+        size_t index;
+        pid_t pid;
+        // stdout, stderr, and status. -1 when closed
+        int fds[3];
+        std::string data[3];
+        bool started = false;
+        bool killed = false;
+        // The end of the setup time until main starts, then the end of the time limit
+        clock::time_point deadline;
+    };
+
+    std::vector<TestCaseResult> results(cases.size());
+    std::vector<Child> children;
+    size_t next = 0;
+
+    auto launch = [&](size_t index) {
+        int pipes[3][2];
+        for (auto& p : pipes)
+            if (pipe(p) != 0)
+                report_internal_error("Can't create a pipe for a test case");
+
+        // Otherwise, the buffered output of the parent is written by the child as well
+        std::cout.flush();
+        std::cerr.flush();
+        std::fflush(nullptr);
+
+        pid_t pid = fork();
+        if (pid < 0)
+            report_internal_error("Can't fork a process for a test case");
+
+        if (pid == 0) {
+            dup2(pipes[0][1], STDOUT_FILENO);
+            dup2(pipes[1][1], STDERR_FILENO);
+            for (auto& p : pipes)
+                close(p[0]);
+            close(pipes[0][1]);
+            close(pipes[1][1]);
+            run_child(cases[index], args, whole_program, pipes[2][1]);
+        }
+
+        Child child { index, pid };
+        child.deadline = clock::now() + SETUP_TIME_LIMIT;
+        for (int i = 0; i < 3; i++) {
+            close(pipes[i][1]);
+            child.fds[i] = pipes[i][0];
+        }
+        children.push_back(std::move(child));
+    };
+
+    auto finish = [&](Child& child) {
+        int status = 0;
+        while (waitpid(child.pid, &status, 0) < 0 && errno == EINTR);
+
+        auto& result = results[child.index];
+        auto& statuses = child.data[2];
+        result.execution.std_out = normalize_output(child.data[0]);
+        result.execution.std_err = normalize_output(child.data[1]);
+        result.execution.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : WTERMSIG(status);
+
+        bool signaled = WIFSIGNALED(status);
+        if (child.killed && !child.started)
+            result.execution_error = "The case didn't start running within "
+                                     + std::to_string(SETUP_TIME_LIMIT.count()) + " seconds";
+        else if (statuses.find(COMPILATION_THREW) != std::string::npos)
+            result.compilation_threw = true;
+        else if (statuses.find(COMPILED) == std::string::npos)
+            result.execution_error = "The compiler crashed with the signal " + std::to_string(WTERMSIG(status));
+        else if (child.killed || (signaled && WTERMSIG(status) == SIGALRM))
+            result.timed_out = true;
+        else if (statuses.find(EXECUTION_FAILED) != std::string::npos)
+            result.execution_error = child.data[1];
+    };
+
+    while (next < cases.size() || !children.empty())
+    {
+        while (children.size() < jobs && next < cases.size()) {
+            if (!cases[next].preprocessed.empty())
+                launch(next);
+            next++;
+        }
+
+        if (children.empty())
+            break;
+
+        // Whether the child gets killed at its deadline
+        auto has_deadline = [&](const Child& child) {
+            return !child.killed && (!child.started || cases[child.index].time_limit >= 0);
+        };
+
+        std::vector<pollfd> fds;
+        std::vector<std::pair<size_t, int>> owners;
+        int timeout = -1;
+        auto now = clock::now();
+        for (size_t i = 0; i < children.size(); i++) {
+            auto& child = children[i];
+            for (int j = 0; j < 3; j++) {
+                if (child.fds[j] != -1) {
+                    fds.push_back({ child.fds[j], POLLIN, 0 });
+                    owners.emplace_back(i, j);
+                }
+            }
+            if (has_deadline(child)) {
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(child.deadline - now).count();
+                remaining = std::max<long long>(remaining, 0) + 1;
+                if (timeout == -1 || remaining < timeout)
+                    timeout = (int)remaining;
+            }
+        }
+
+        if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR)
+            report_internal_error("Can't poll the outputs of the test cases");
+
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (fds[i].revents == 0)
+                continue;
+            auto [owner, j] = owners[i];
+            auto& child = children[owner];
+            char buffer[4096];
+            auto count = read(fds[i].fd, buffer, sizeof(buffer));
+            if (count > 0) {
+                child.data[j].append(buffer, count);
+                if (j == 2 && !child.started && child.data[j].find(STARTED) != std::string::npos) {
+                    child.started = true;
+                    child.deadline = clock::now() + std::chrono::milliseconds(cases[child.index].time_limit);
+                }
+            } else if (count == 0 || errno != EINTR) {
+                close(fds[i].fd);
+                child.fds[j] = -1;
+            }
+        }
+
+        now = clock::now();
+        for (size_t i = 0; i < children.size();) {
+            auto& child = children[i];
+            if (has_deadline(child) && now >= child.deadline) {
+                kill(child.pid, SIGKILL);
+                child.killed = true;
+            }
+            if (child.fds[0] == -1 && child.fds[1] == -1 && child.fds[2] == -1) {
+                finish(child);
+                children.erase(children.begin() + i);
+            } else {
+                i++;
+            }
+        }
+    }
+
+    return results;
+}
+
+#endif
+
+// DUA_TEST_RUNNER=clang compiles each case into an executable using clang
+//  instead. The JIT runner is not available on Windows, since it uses fork.
+static bool use_jit_runner()
+{
+#ifdef _WIN32
+    return false;
+#else
+    auto runner = std::getenv("DUA_TEST_RUNNER");
+    return runner == nullptr || std::string(runner) != "clang";
+#endif
+}
+
+// DUA_TEST_JOBS limits the number of cases that run in parallel
+static size_t get_test_jobs()
+{
+    if (auto jobs = std::getenv("DUA_TEST_JOBS"); jobs != nullptr) {
+        try {
+            return std::max(std::stoul(jobs), 1UL);
+        } catch (...) {}
+    }
+    return std::max(std::thread::hardware_concurrency(), 1U);
+}
+
 void FileTestCasesRunner::run()
 {
     auto path = std::filesystem::weakly_canonical(TESTS_PATH + filename).string();
@@ -18,124 +385,129 @@ void FileTestCasesRunner::run()
     auto tests = split_cases(tests_str);
     try
     {
-        int passed_cases = 0;
+        // All the cases are parsed first, so that they
+        //  can be executed in parallel in the JIT mode.
+        std::vector<TestCase> cases(tests.cases.size());
         for (size_t i = 0; i < tests.cases.size(); i++)
         {
+            auto& test = cases[i];
             auto [header, body] = split_header_body(tests.cases[i]);
-            auto name = extract_header_element(header, "Case");
+            test.name = extract_header_element(header, "Case");
 
-            std::cerr << std::left << std::setw(60) << "Test " + std::to_string(i + 1) + ": " + name;
-            std::cerr.flush();
-
-            auto expected_exit_code_str = extract_header_element(header, "Returns");
-            auto expected_time_limit_str = extract_header_element(header, "Time Limit");
-            auto expected_output = extract_header_element(header, "Outputs");
-            bool exceeds_time_limit = header_has_flag(header, "Exceeds time limit");
-            bool expected_output_is_empty = true;
-            if (expected_output.size() >= 2) {
-                expected_output_is_empty = false;
-                expected_output = escape_characters(expected_output.substr(1, expected_output.size() - 2));
-            } else if (!expected_output.empty()) {
-                report_error(name + ": in test case " + std::to_string(i + 1) +
+            test.expected_exit_code_str = extract_header_element(header, "Returns");
+            test.expected_time_limit_str = extract_header_element(header, "Time Limit");
+            test.expected_output = extract_header_element(header, "Outputs");
+            test.exceeds_time_limit = header_has_flag(header, "Exceeds time limit");
+            if (test.expected_output.size() >= 2) {
+                test.expected_output_is_empty = false;
+                test.expected_output = escape_characters(test.expected_output.substr(1, test.expected_output.size() - 2));
+            } else if (!test.expected_output.empty()) {
+                report_error(test.name + ": in test case " + std::to_string(i + 1) +
                              ", the expected output should be in-between \"\".");
             }
-            bool should_panic = header_has_flag(header, "Panics");
-
-            Preprocessor preprocessor;
-            std::string code = tests.common + '\n' + body;
-            std::string preprocessed;
-
-            if (should_panic) {
-                try {
-                    preprocessed = preprocessor.process(path, code);
-                } catch (...) {
-                    EXPECT_NO_THROW(true);
-                    std::cerr << "Panicked at the preprocessing stage. Passed!\n";
-                    passed_cases++;
-                    continue;
-                }
-            } else {
-                EXPECT_NO_THROW(preprocessed = preprocessor.process(path, code)) << "Panicked at the preprocessing stage\n";
-            }
-
-            if (preprocessed.empty()) {
-                // The preprocessor threw an exception
-                continue;
-            }
+            test.should_panic = header_has_flag(header, "Panics");
 
-            if (!expected_output.empty() && expected_output.back() != '\n') {
+            if (!test.expected_output.empty() && test.expected_output.back() != '\n') {
                 // This is to match the output of the program execution, which
                 //  will append a \n to the output if there isn't one.
-                expected_output.push_back('\n');
+                test.expected_output.push_back('\n');
             }
 
             // TODO encode the name in a more collision-prone way
-            auto encoded_name = name;
-            for (auto& c : encoded_name) {
+            test.encoded_name = test.name;
+            for (auto& c : test.encoded_name) {
                 if (c == ' ') c = '_';
                 else if (!std::isalpha(c)) c = '-';
             }
 
-            // Windows will complain if the extension is not .exe,
-            //  and it doesn't hurt when run on Unix-based systems.
-            auto exe_name = encoded_name + ".exe";
+            for (auto& ch : test.expected_time_limit_str) ch = std::tolower(ch);
+            if (test.expected_time_limit_str.empty()) {
+                test.time_limit = 2000, test.expected_time_limit_str = "2000";  // 2 seconds
+            } else if (test.expected_time_limit_str != "infinite") {
+                try {
+                    test.time_limit = std::stol(test.expected_time_limit_str);
+                } catch (std::exception& e) {
+                    std::cerr << "Invalid time limit: '" + test.expected_time_limit_str + "'\n";
+                    FAIL();
+                }
+            }
+
+            Preprocessor preprocessor;
+            std::string code = tests.common + '\n' + body;
+            try {
+                test.preprocessed = preprocessor.process(path, code);
+            } catch (...) {
+                test.preprocessed.clear();
+            }
+        }
+
+        bool jit = use_jit_runner();
+        std::vector<TestCaseResult> results;
+#ifndef _WIN32
+        if (jit)
+            results = run_in_child_processes(cases, args, whole_program, get_test_jobs());
+#endif
 
-            std::vector<std::string> n = { encoded_name };
-            std::vector<std::string> c = { preprocessed };
-            std::vector<std::string> a = { "-o", exe_name, PROJECT_ROOT_DIR + "/lib/common.c" };
+        int passed_cases = 0;
+        for (size_t i = 0; i < cases.size(); i++)
+        {
+            auto& test = cases[i];
+
+            std::cerr << std::left << std::setw(60) << "Test " + std::to_string(i + 1) + ": " + test.name;
+            std::cerr.flush();
+
+            if (test.preprocessed.empty()) {
+                // The preprocessor threw an exception
+                if (test.should_panic) {
+                    std::cerr << "Panicked at the preprocessing stage. Passed!\n";
+                    passed_cases++;
+                } else {
+                    ADD_FAILURE() << "Panicked at the preprocessing stage\n";
+                }
+                continue;
+            }
 
-            bool succeeded;
+            auto result = jit ? std::move(results[i]) : run_with_clang(test, args, whole_program);
+            auto& execution = result.execution;
 
-            if (should_panic) {
-                succeeded = true;
-                EXPECT_ANY_THROW(succeeded = !run_clang_on_llvm_ir(n, c, a, false, false));
+            if (test.should_panic) {
+                bool succeeded = result.compilation_threw;
+                EXPECT_TRUE(succeeded) << "Expected the compilation to throw an exception";
+                if (!result.execution_error.empty())
+                    std::cerr << result.execution_error << '\n';
                 if (succeeded)
                     std::cerr << termcolor::green << "\t\tException thrown, Passed!" << termcolor::reset << '\n';
                 passed_cases += succeeded;
                 continue;
-            } else {
-                succeeded = false;
-                EXPECT_NO_THROW(succeeded = run_clang_on_llvm_ir(n, c, a, false, false));
             }
 
-            long long time_limit = -1;
-            for (auto& ch : expected_time_limit_str) ch = std::tolower(ch);
-            if (expected_time_limit_str.empty()) {
-                time_limit = 2000, expected_time_limit_str = "2000";  // 2 seconds
-            } else if (expected_time_limit_str != "infinite") {
-                try {
-                    time_limit = std::stol(expected_time_limit_str);
-                } catch (std::exception& e) {
-                    std::cerr << "Invalid time limit: '" + expected_time_limit_str + "'\n";
-                    FAIL();
-                }
+            if (result.compilation_threw) {
+                ADD_FAILURE() << "Panicked at the compilation stage\n";
+                continue;
             }
 
-            ProgramExecution execution;
-
-            try {
-                execution = execute_program(exe_name, args, time_limit);
-            } catch (TLEException& e) {
-                std::cerr << "Time limit of " + expected_time_limit_str + "ms exceeded. ";
-                std::cerr << (exceeds_time_limit ? "Passed!\n" : "Failed\n");
-                std::filesystem::remove(exe_name);
-                EXPECT_TRUE(exceeds_time_limit);
+            if (result.timed_out) {
+                std::cerr << "Time limit of " + test.expected_time_limit_str + "ms exceeded. ";
+                std::cerr << (test.exceeds_time_limit ? "Passed!\n" : "Failed\n");
+                EXPECT_TRUE(test.exceeds_time_limit);
                 continue;
-            } catch (std::exception& e) {
-                std::cerr << "Panicked at the program execution stage with message '" << e.what() << "'\n";
-                std::filesystem::remove(exe_name);
+            }
+
+            if (!result.execution_error.empty()) {
+                std::cerr << "Panicked at the program execution stage with message '" << result.execution_error << "'\n";
                 EXPECT_FALSE("Panicked at the program execution stage");
                 continue;
             }
 
-            std::filesystem::remove(exe_name);
+            bool succeeded = true;
 
-            if (!expected_output_is_empty) {
-                EXPECT_EQ(expected_output, execution.std_out);
-                if (expected_output != execution.std_out)
+            if (!test.expected_output_is_empty) {
+                EXPECT_EQ(test.expected_output, execution.std_out);
+                if (test.expected_output != execution.std_out)
                     succeeded = false;
             }
 
+            auto expected_exit_code_str = test.expected_exit_code_str;
             if (expected_exit_code_str.empty()) expected_exit_code_str = "0";
             int expected_exit_code;
             try {
@@ -165,4 +537,4 @@ void FileTestCasesRunner::run()
     }
 }
 
-}
\ No newline at end of file
+}
@@ -9,13 +9,15 @@ class FileTestCasesRunner
 {
     std::string filename;
     std::vector<std::string> args;
+    // Whether the cases are compiled the same way -whole-program does
+    bool whole_program;
 
     const std::string TESTS_PATH = PROJECT_ROOT_DIR + "/examples/";
 
 public:
 
-    explicit FileTestCasesRunner(std::string filename, std::vector<std::string> args = {})
-        : filename(std::move(filename)), args(std::move(args)) {}
+    explicit FileTestCasesRunner(std::string filename, std::vector<std::string> args = {}, bool whole_program = false)
+        : filename(std::move(filename)), args(std::move(args)), whole_program(whole_program) {}
 
     void run();
 };
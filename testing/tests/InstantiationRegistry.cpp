@@ -0,0 +1,57 @@
+#include <ModuleCompiler.hpp>
+#include <resolution/InstantiationRegistry.hpp>
+#include <llvm/IR/Module.h>
+#include <gtest/gtest.h>
+
+namespace dua
+{
+
+TEST(instantiation_registry, first_module_owns_the_instance) {
+    InstantiationRegistry registry({ "a.dua", "b.dua", "c.dua" });
+
+    // The order of the definitions depends on the scheduling of the modules
+    registry.add_definition("Templated.f", "c.dua");
+    registry.add_definition("Templated.f", "b.dua");
+    registry.add_definition("Templated.g", "c.dua");
+
+    ASSERT_FALSE(registry.is_owner("Templated.f", "a.dua"));
+    ASSERT_TRUE(registry.is_owner("Templated.f", "b.dua"));
+    ASSERT_FALSE(registry.is_owner("Templated.f", "c.dua"));
+    ASSERT_TRUE(registry.is_owner("Templated.g", "c.dua"));
+}
+
+TEST(instantiation_registry, template_instance_names) {
+    ASSERT_TRUE(InstantiationRegistry::is_template_instance("Templated.f<i32>"));
+    ASSERT_FALSE(InstantiationRegistry::is_template_instance("f"));
+}
+
+static const std::string code = R"(
+int twice<T>(T x) { return x * 2; }
+int f() { return twice<int>(1); }
+)";
+
+static bool defines(ModuleCompiler& compiler, const std::string& name)
+{
+    for (auto& function : *compiler.get_module())
+        if (!function.isDeclaration() && function.getName().str().find(name) != std::string::npos)
+            return true;
+    return false;
+}
+
+TEST(instantiation_registry, owners_do_not_depend_on_the_generation_order) {
+    InstantiationRegistry registry({ "a.dua", "b.dua" });
+
+    // The second module is generated first
+    ModuleCompiler b("b.dua", code, false, &registry);
+    ModuleCompiler a("a.dua", code, false, &registry);
+    b.declare_instances_owned_elsewhere();
+    a.declare_instances_owned_elsewhere();
+
+    ASSERT_TRUE(defines(a, "twice"));
+    ASSERT_FALSE(defines(b, "twice"));
+    // Only template instances are shared
+    ASSERT_TRUE(defines(a, "f"));
+    ASSERT_TRUE(defines(b, "f"));
+}
+
+}
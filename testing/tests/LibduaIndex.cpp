@@ -0,0 +1,38 @@
+#include <LibduaIndex.hpp>
+#include <ModuleCompiler.hpp>
+#include <gtest/gtest.h>
+
+namespace dua
+{
+
+// The dependencies between the chunks are found by scanning their tokens, so a
+//  missed dependency only shows up once a chunk is compiled without the chunk
+//  it depends on. The bodies of templates are only checked once instantiated.
+
+TEST(libdua_index, whole_library_compiles) {
+    std::string declarations;
+    for (auto& chunk : get_libdua_declarations())
+        declarations += chunk;
+    ASSERT_NO_THROW(ModuleCompiler("libdua", declarations, false));
+}
+
+TEST(libdua_index, each_chunk_compiles_with_its_dependencies_only) {
+    auto& index = LibduaIndex::get();
+    ASSERT_EQ(index.chunk_count(), get_libdua_declarations().size());
+    for (size_t i = 0; i < index.chunk_count(); i++) {
+        auto declarations = index.get_chunk_declarations(i);
+        EXPECT_NO_THROW(ModuleCompiler("chunk_" + std::to_string(i), declarations, false))
+            << "The dependencies of the chunk " << i << " are incomplete:\n" << get_libdua_declarations()[i];
+    }
+}
+
+TEST(libdua_index, needed_declarations_follow_the_references) {
+    auto& index = LibduaIndex::get();
+    ASSERT_EQ(index.get_needed_declarations("int main() { return 0; }"), "");
+
+    // A string literal is a String object when libdua is included
+    auto declarations = index.get_needed_declarations("int main() { printf(\"Hi\"); }");
+    ASSERT_NE(declarations.find("class String"), std::string::npos);
+}
+
+}
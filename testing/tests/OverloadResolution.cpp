@@ -0,0 +1,63 @@
+#include <ModuleCompiler.hpp>
+#include <resolution/FunctionNameResolver.hpp>
+#include <types/IntegerTypes.hpp>
+#include <types/VoidType.hpp>
+#include <types/FunctionType.hpp>
+#include <gtest/gtest.h>
+
+namespace dua
+{
+
+struct OverloadResolutionTest : testing::Test
+{
+    ModuleCompiler compiler { "overloads", "", false };
+    FunctionNameResolver resolver { &compiler };
+    const Type* i32 = compiler.create_type<I32Type>();
+    const Type* i64 = compiler.create_type<I64Type>();
+
+    // Registers f with the given parameters, and returns its full name
+    std::string register_f(std::vector<const Type*> params)
+    {
+        auto type = compiler.create_type<FunctionType>(compiler.create_type<VoidType>(), params);
+        std::vector<std::string> param_names(params.size(), "x");
+        resolver.register_function("f", FunctionInfo { type, std::move(param_names) });
+        return FunctionNameResolver::get_function_full_name("f", params);
+    }
+};
+
+TEST_F(OverloadResolutionTest, repeated_resolutions_give_the_same_winner) {
+    auto f_i64 = register_f({ i64 });
+    ASSERT_EQ(resolver.get_winning_function("f", { i32 }), f_i64);
+    ASSERT_EQ(resolver.get_winning_function("f", { i32 }), f_i64);
+    ASSERT_EQ(resolver.get_winning_function("f", { i64 }), f_i64);
+}
+
+TEST_F(OverloadResolutionTest, later_better_overload_wins) {
+    auto f_i64 = register_f({ i64 });
+    ASSERT_EQ(resolver.get_winning_function("f", { i32 }), f_i64);
+
+    // The memoized resolution must not hide the exact match
+    auto f_i32 = register_f({ i32 });
+    ASSERT_EQ(resolver.get_winning_function("f", { i32 }), f_i32);
+    ASSERT_EQ(resolver.get_winning_function("f", { i64 }), f_i64);
+}
+
+TEST_F(OverloadResolutionTest, later_overload_is_found) {
+    register_f({ i64 });
+    ASSERT_EQ(resolver.get_winning_function("f", { i64, i64 }, false), "");
+
+    auto f_i64_i64 = register_f({ i64, i64 });
+    ASSERT_EQ(resolver.get_winning_function("f", { i64, i64 }, false), f_i64_i64);
+}
+
+TEST_F(OverloadResolutionTest, other_names_are_not_affected) {
+    auto f_i64 = register_f({ i64 });
+    ASSERT_EQ(resolver.get_winning_function("f", { i32 }), f_i64);
+
+    // Shares a prefix with f, but isn't one of its overloads
+    auto type = compiler.create_type<FunctionType>(compiler.create_type<VoidType>(), std::vector<const Type*> { i32 });
+    resolver.register_function("ff", FunctionInfo { type, { "x" } });
+    ASSERT_EQ(resolver.get_winning_function("f", { i32 }), f_i64);
+}
+
+}
@@ -0,0 +1,101 @@
+#include <utils/CodeGeneration.hpp>
+#include <utils/ErrorReporting.hpp>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+
+namespace dua
+{
+
+// Writes the files into a new temporary directory, and returns their paths
+static strings write_files(const strings& names, const strings& code)
+{
+    auto directory = std::filesystem::temp_directory_path() / uuid();
+    std::filesystem::create_directory(directory);
+    strings paths;
+    for (size_t i = 0; i < names.size(); i++) {
+        paths.push_back((directory / names[i]).string());
+        std::ofstream(paths.back()) << code[i];
+    }
+    return paths;
+}
+
+static size_t count_occurrences(const std::string& text, const std::string& pattern)
+{
+    size_t count = 0;
+    for (auto i = text.find(pattern); i != std::string::npos; i = text.find(pattern, i + 1))
+        count++;
+    return count;
+}
+
+static const strings failing_code = {
+    "int main() { return missing_a(); }",
+    "int f() { return 0; }",
+    "int g() { return missing_c(); }",
+};
+
+TEST(parallel_compilation, errors_are_reported_in_the_order_of_the_files) {
+    auto paths = write_files({ "a.o", "b.o", "c.o" }, { "", "", "" });
+    CompilationOptions options;
+    options.include_libdua = false;
+    options.jobs = 3;
+
+    for (int attempt = 0; attempt < 5; attempt++) {
+        testing::internal::CaptureStderr();
+        EXPECT_THROW(emit_modules({ "a.dua", "b.dua", "c.dua" }, failing_code, paths, OutputKind::OBJECT, options),
+                     ReportedError);
+        auto output = testing::internal::GetCapturedStderr();
+
+        ASSERT_EQ(count_occurrences(output, "missing_a"), 1) << output;
+        ASSERT_EQ(count_occurrences(output, "missing_c"), 1) << output;
+        ASSERT_LT(output.find("missing_a"), output.find("missing_c")) << output;
+    }
+
+    std::filesystem::remove_all(std::filesystem::path(paths[0]).parent_path());
+}
+
+TEST(parallel_compilation, outputs_match_the_sequential_build) {
+    strings code = { "int f() { return 1; }", "int g() { return 2; }", "int main() { return 0; }" };
+    strings names = { "a.dua", "b.dua", "c.dua" };
+    auto sequential = write_files({ "a.ll", "b.ll", "c.ll" }, { "", "", "" });
+    auto parallel = write_files({ "a.ll", "b.ll", "c.ll" }, { "", "", "" });
+
+    CompilationOptions options;
+    options.include_libdua = false;
+    emit_modules(names, code, sequential, OutputKind::LLVM_IR, options);
+    options.jobs = 3;
+    emit_modules(names, code, parallel, OutputKind::LLVM_IR, options);
+
+    for (size_t i = 0; i < names.size(); i++) {
+        std::ifstream first(sequential[i]), second(parallel[i]);
+        std::string first_str((std::istreambuf_iterator<char>(first)), {});
+        std::string second_str((std::istreambuf_iterator<char>(second)), {});
+        ASSERT_FALSE(first_str.empty());
+        ASSERT_EQ(first_str, second_str);
+    }
+
+    std::filesystem::remove_all(std::filesystem::path(sequential[0]).parent_path());
+    std::filesystem::remove_all(std::filesystem::path(parallel[0]).parent_path());
+}
+
+TEST(parallel_compilation, errors_are_printed_once) {
+    auto paths = write_files({ "a.dua", "b.dua" }, { "int main() { return missing_a(); }", "int f() { return missing_b(); }" });
+    CompilationOptions options;
+    options.include_libdua = false;
+    options.jobs = 2;
+    // The error of the first file must not be printed again after the diagnostics
+    EXPECT_EXIT(compile(paths, { "-c" }, options), testing::ExitedWithCode(1),
+                "missing_a is not defined\n.*missing_b is not defined\n$");
+}
+
+TEST(parallel_compilation, output_file_with_multiple_outputs) {
+    auto paths = write_files({ "a.dua", "b.dua" }, { "int f() { return 1; }", "int g() { return 2; }" });
+    CompilationOptions options;
+    options.include_libdua = false;
+    EXPECT_EXIT(compile(paths, { "-c", "-o", "out.o" }, options), testing::ExitedWithCode(1),
+                "cannot specify -o when generating multiple output files");
+    EXPECT_EXIT(compile(paths, { "-S", "-o", "out.s" }, options), testing::ExitedWithCode(1),
+                "cannot specify -o when generating multiple output files");
+}
+
+}
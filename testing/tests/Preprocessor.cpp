@@ -1,4 +1,9 @@
 #include "FileTestCasesRunner.hpp"
+#include <Preprocessor.hpp>
+#include <utils/CodeGeneration.hpp>
+#include <utils/TextManipulation.hpp>
+#include <filesystem>
+#include <fstream>
 
 namespace dua
 {
@@ -7,4 +12,100 @@ TEST(preprocessor, preprocessor) {
     FileTestCasesRunner("preprocessor.dua").run();
 }
 
+static std::filesystem::path create_temp_directory()
+{
+    auto directory = std::filesystem::temp_directory_path() / uuid();
+    std::filesystem::create_directory(directory);
+    return directory;
+}
+
+static void write_file(const std::filesystem::path& path, const std::string& content) {
+    std::ofstream(path, std::ios::binary) << content;
+}
+
+TEST(preprocessor, shared_import_graph_reads_each_file_once) {
+    auto directory = create_temp_directory();
+    write_file(directory / "common.dua", "int common() { return 1; }\n");
+    write_file(directory / "a.dua", "import \"common.dua\"\nint a() { return common(); }\n");
+    write_file(directory / "b.dua", "import \"common.dua\"\nint b() { return common(); }\n");
+
+    ImportGraph graph;
+    auto a = Preprocessor(&graph).process_file((directory / "a.dua").string()).str();
+
+    // The second importer gets the content that was read by the first one
+    write_file(directory / "common.dua", "int common() { return 2; }\n");
+    auto b = Preprocessor(&graph).process_file((directory / "b.dua").string()).str();
+
+    ASSERT_NE(a.find("return 1;"), std::string::npos) << a;
+    ASSERT_NE(b.find("return 1;"), std::string::npos) << b;
+    ASSERT_NE(b.find("int b()"), std::string::npos) << b;
+
+    auto path = std::filesystem::weakly_canonical(directory / "common.dua").string();
+    ASSERT_EQ(&graph.get_file(path), &graph.get_file(path));
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST(preprocessor, shared_import_graph_matches_separate_preprocessing) {
+    auto directory = create_temp_directory();
+    write_file(directory / "common.dua", "int common() { return 1; }\n");
+    write_file(directory / "other.dua", "import \"common.dua\"\nint other() { return 2; }\n");
+    write_file(directory / "a.dua", "import \"other.dua\"\nimport \"common.dua\"\nint a() { return 3; }\n");
+
+    ImportGraph graph;
+    auto path = (directory / "a.dua").string();
+    auto shared = Preprocessor(&graph).process_file(path).str();
+    auto shared_again = Preprocessor(&graph).process_file(path).str();
+    auto separate = Preprocessor().process_file(path).str();
+
+    ASSERT_EQ(shared, separate);
+    ASSERT_EQ(shared_again, separate);
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST(preprocessor, imports_are_relative_to_the_importing_file) {
+    auto directory = create_temp_directory();
+    std::filesystem::create_directory(directory / "sub");
+    write_file(directory / "common.dua", "int common() { return 1; }\n");
+    write_file(directory / "sub" / "helper.dua", "import \"../common.dua\"\nint helper() { return 2; }\n");
+    write_file(directory / "a.dua", "import \"sub/helper.dua\"\nint a() { return 3; }\n");
+
+    auto working_directory = std::filesystem::current_path();
+    auto result = Preprocessor().process_file((directory / "a.dua").string()).str();
+
+    ASSERT_EQ(std::filesystem::current_path(), working_directory);
+    ASSERT_LT(result.find("int common()"), result.find("int helper()")) << result;
+    ASSERT_LT(result.find("int helper()"), result.find("int a()")) << result;
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST(preprocessor, line_endings_are_normalized) {
+    auto directory = create_temp_directory();
+    write_file(directory / "common.dua", "int common()\r\n{ return 1; }\r\n");
+    write_file(directory / "a.dua", "import \"common.dua\"\r\nint a() { return 3; }\r\n");
+
+    auto path = (directory / "a.dua").string();
+    auto result = Preprocessor().process_file(path).str();
+    ASSERT_EQ(result.find('\r'), std::string::npos) << result;
+    ASSERT_EQ(read_file(path), "import \"common.dua\"\nint a() { return 3; }\n");
+    ASSERT_EQ(normalize_line_endings("a\r\nb\rc\r"), "a\nb\rc\r");
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST(preprocessor, new_lines_are_only_added_after_imports) {
+    auto directory = create_temp_directory();
+    write_file(directory / "common.dua", "int common() { return 1; } // The end");
+    write_file(directory / "a.dua", "import \"common.dua\" int a() { return 3; }");
+
+    auto path = (directory / "a.dua").string();
+    auto result = Preprocessor().process_file(path).str();
+    // The comment doesn't extend over the rest of the importing file, which doesn't get a new line
+    ASSERT_EQ(result, "int common() { return 1; } // The end\n int a() { return 3; }");
+
+    std::filesystem::remove_all(directory);
+}
+
 }
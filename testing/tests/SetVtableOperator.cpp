@@ -7,4 +7,8 @@ TEST(set_vtable, set_vtable) {
     FileTestCasesRunner("set-vtable-operator.dua").run();
 }
 
+TEST(set_vtable, whole_program) {
+    FileTestCasesRunner("set-vtable-operator.dua", {}, true).run();
+}
+
 }
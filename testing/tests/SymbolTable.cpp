@@ -0,0 +1,46 @@
+#include <SymbolTable.hpp>
+#include <gtest/gtest.h>
+
+namespace dua
+{
+
+static std::vector<std::string> live_symbols(const Scope<int>& scope)
+{
+    std::vector<std::string> symbols;
+    for (size_t i = 0; i < scope.map.size(); i++)
+        if (!scope.is_erased(i))
+            symbols.push_back(scope.map[i].symbol);
+    return symbols;
+}
+
+TEST(scope, erasing_keeps_the_insertion_order) {
+    Scope<int> scope(nullptr);
+    for (int i = 0; i < 6; i++)
+        scope.insert("s" + std::to_string(i), i);
+
+    scope.erase("s1");
+    scope.erase("s5");
+    scope.move_erase("s3");
+    scope.insert("s1", 10);
+
+    ASSERT_EQ(live_symbols(scope), std::vector<std::string>({ "s0", "s2", "s4", "s1" }));
+    ASSERT_EQ(scope.get("s1"), 10);
+    ASSERT_EQ(scope.get("s4"), 4);
+    ASSERT_FALSE(scope.contains("s3"));
+    ASSERT_TRUE(scope.is_move_erased("s3"));
+    ASSERT_LT(scope.insertion_order("s4"), scope.insertion_order("s1"));
+}
+
+TEST(scope, erased_entries_are_removed_eventually) {
+    Scope<int> scope(nullptr);
+    for (int i = 0; i < 1000; i++)
+        scope.insert("s" + std::to_string(i), i);
+    for (int i = 0; i < 999; i++)
+        scope.erase("s" + std::to_string(i));
+
+    ASSERT_LE(scope.map.size(), 2);
+    ASSERT_EQ(live_symbols(scope), std::vector<std::string>({ "s999" }));
+    ASSERT_EQ(scope.get("s999"), 999);
+}
+
+}
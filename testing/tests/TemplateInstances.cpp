@@ -0,0 +1,83 @@
+#include <ModuleCompiler.hpp>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/InstrTypes.h>
+#include <gtest/gtest.h>
+
+namespace dua
+{
+
+static const std::string code = R"(
+T pick<T>(T x) { return x; }
+
+class Box<T>
+{
+    T value = 0;
+    T get() { return value; }
+}
+
+int use_int() { return pick<int>(1) + pick<int>(2) + pick<int>(3); }
+long use_long() { return pick<long>(4); }
+int use_boxes() { Box<int> a; Box<int> b; Box<long> c; return a.get() + b.get() + (int)c.get(); }
+
+int main() { return 0; }
+)";
+
+// The names of the defined functions that start with the given prefix and contain the given part
+static std::vector<std::string> get_defined_functions(llvm::Module& module, const std::string& prefix, const std::string& part = "")
+{
+    std::vector<std::string> result;
+    for (auto& function : module) {
+        auto name = function.getName().str();
+        if (!function.isDeclaration() && name.rfind(prefix, 0) == 0 && name.find(part) != std::string::npos)
+            result.push_back(std::move(name));
+    }
+    return result;
+}
+
+// The names of the functions that are called directly from the given function
+static std::vector<std::string> get_callees(llvm::Module& module, const std::string& caller)
+{
+    std::vector<std::string> result;
+    for (auto& block : *module.getFunction(caller))
+        for (auto& instruction : block)
+            if (auto call = llvm::dyn_cast<llvm::CallBase>(&instruction))
+                if (auto callee = call->getCalledFunction(); callee != nullptr && !callee->isIntrinsic())
+                    result.push_back(callee->getName().str());
+    return result;
+}
+
+TEST(template_instances, repeated_uses_share_the_instance) {
+    ModuleCompiler compiler("templates", code, false);
+    auto& module = *compiler.get_module();
+
+    auto callees = get_callees(module, "use_int()");
+    ASSERT_EQ(callees.size(), 3);
+    ASSERT_EQ(callees[0], callees[1]);
+    ASSERT_EQ(callees[0], callees[2]);
+}
+
+TEST(template_instances, different_arguments_give_different_instances) {
+    ModuleCompiler compiler("templates", code, false);
+    auto& module = *compiler.get_module();
+
+    auto instances = get_defined_functions(module, "pick.");
+    ASSERT_EQ(instances.size(), 2);
+    ASSERT_NE(instances[0], instances[1]);
+
+    auto int_callees = get_callees(module, "use_int()");
+    auto long_callees = get_callees(module, "use_long()");
+    ASSERT_EQ(long_callees.size(), 1);
+    ASSERT_NE(int_callees[0], long_callees[0]);
+}
+
+TEST(template_instances, templated_class_is_instantiated_once_per_arguments) {
+    ModuleCompiler compiler("templates", code, false);
+    auto& module = *compiler.get_module();
+
+    // One instance for Box<int>, which is used twice, and one for Box<long>
+    auto getters = get_defined_functions(module, "Box.", ".get(");
+    ASSERT_EQ(getters.size(), 2);
+    ASSERT_NE(getters[0], getters[1]);
+}
+
+}
@@ -0,0 +1,118 @@
+#include <utils/TimeReport.hpp>
+#include <utils/CodeGeneration.hpp>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <gtest/gtest.h>
+
+namespace dua
+{
+
+static size_t count_occurrences(const std::string& text, const std::string& pattern)
+{
+    size_t count = 0;
+    for (auto i = text.find(pattern); i != std::string::npos; i = text.find(pattern, i + 1))
+        count++;
+    return count;
+}
+
+TEST(time_report, merging_adds_the_phases_and_the_counters) {
+    TimeReport first { "first" }, second { "second" };
+    first.add_time("Parsing", { 1, 2 });
+    first.add_to_counter("AST nodes", 3);
+    second.add_time("Parsing", { 1, 1 });
+    second.add_time("Emission", { 4, 4 });
+    second.add_to_counter("AST nodes", 4);
+
+    first.merge(second);
+    ASSERT_EQ(first.phases.size(), 2);
+    ASSERT_EQ(first.phases[0].first, "Parsing");
+    ASSERT_DOUBLE_EQ(first.phases[0].second.wall, 2);
+    ASSERT_DOUBLE_EQ(first.phases[0].second.cpu, 3);
+    ASSERT_EQ(first.phases[1].first, "Emission");
+    ASSERT_EQ(first.counters.size(), 1);
+    ASSERT_EQ(first.counters[0].second, 7);
+
+    std::ostringstream stream;
+    first.print(stream);
+    ASSERT_NE(stream.str().find("Dua time report: first"), std::string::npos);
+    ASSERT_NE(stream.str().find("AST nodes"), std::string::npos);
+}
+
+// The time report and the trace are enabled for the rest of the
+//  process, so the tests that need them run after the ones that don't
+TEST(time_report, files_with_the_same_name_get_separate_reports) {
+    enable_time_report();
+
+    auto directory = std::filesystem::temp_directory_path() / uuid();
+    std::filesystem::create_directory(directory);
+    strings outputs = { (directory / "1.ll").string(), (directory / "2.ll").string() };
+
+    CompilationOptions options;
+    options.include_libdua = false;
+    options.jobs = 2;
+    register_file_reports({ "a.dua", "a.dua" });
+    emit_modules({ "a.dua", "a.dua" }, { "int f() { return 1; }", "int g() { return 2; }" }, outputs,
+                 OutputKind::LLVM_IR, options);
+
+    std::ostringstream stream;
+    print_time_reports(stream);
+    auto report = stream.str();
+
+    ASSERT_EQ(count_occurrences(report, "Dua time report: a.dua"), 2) << report;
+    ASSERT_NE(report.find("Dua time report: Total (2 files)"), std::string::npos) << report;
+    // Each file report and the total
+    ASSERT_EQ(count_occurrences(report, "Code generation"), 3) << report;
+    ASSERT_EQ(count_occurrences(report, "Emission"), 3) << report;
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST(time_report, nested_phases_with_the_same_name_are_timed_once) {
+    enable_time_report();
+    register_file_reports({ "nested.dua" });
+    {
+        FileTimeReportScope scope(0);
+        PhaseTimer outer("Template instantiation");
+        PhaseTimer inner("Template instantiation");
+        add_to_counter("Template instantiations");
+    }
+
+    std::ostringstream stream;
+    print_time_reports(stream);
+    auto report = stream.str();
+    // Once in the report of the file, and once in the total
+    ASSERT_EQ(count_occurrences(report, "Template instantiation "), 2) << report;
+    ASSERT_EQ(count_occurrences(report, "Template instantiations"), 2) << report;
+}
+
+TEST(time_report, trace_has_the_phases_of_each_file) {
+    enable_time_report();
+    enable_time_trace();
+
+    auto directory = std::filesystem::temp_directory_path() / uuid();
+    std::filesystem::create_directory(directory);
+    strings outputs = { (directory / "a.ll").string(), (directory / "b.ll").string() };
+    auto trace = (directory / "trace.json").string();
+
+    CompilationOptions options;
+    options.include_libdua = false;
+    options.jobs = 2;
+    register_file_reports({ "a.dua", "b.dua" });
+    emit_modules({ "a.dua", "b.dua" }, { "int f() { return 1; }", "int g() { return 2; }" }, outputs,
+                 OutputKind::LLVM_IR, options);
+    write_time_trace(trace);
+
+    std::ifstream stream(trace);
+    std::string content((std::istreambuf_iterator<char>(stream)), {});
+    ASSERT_NE(content.find("traceEvents"), std::string::npos) << content;
+    ASSERT_NE(content.find("\"Code generation\""), std::string::npos) << content;
+    ASSERT_NE(content.find("\"Emission\""), std::string::npos) << content;
+    ASSERT_NE(content.find("a.dua"), std::string::npos) << content;
+    ASSERT_NE(content.find("b.dua"), std::string::npos) << content;
+    ASSERT_FALSE(is_time_trace_enabled());
+
+    std::filesystem::remove_all(directory);
+}
+
+}
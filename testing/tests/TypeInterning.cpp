@@ -0,0 +1,58 @@
+#include <ModuleCompiler.hpp>
+#include <types/IntegerTypes.hpp>
+#include <types/PointerType.hpp>
+#include <types/ArrayType.hpp>
+#include <types/FunctionType.hpp>
+#include <gtest/gtest.h>
+
+namespace dua
+{
+
+TEST(type_interning, same_arguments_give_the_same_instance) {
+    ModuleCompiler compiler("types", "", false);
+    auto i32 = compiler.create_type<I32Type>();
+    ASSERT_EQ(i32, compiler.create_type<I32Type>());
+
+    auto pointer = compiler.create_type<PointerType>(i32);
+    ASSERT_EQ(pointer, compiler.create_type<PointerType>(compiler.create_type<I32Type>()));
+
+    auto count = compiler.get_typing_system().get_interned_types_count();
+    compiler.create_type<PointerType>(i32);
+    compiler.create_type<I32Type>();
+    ASSERT_EQ(count, compiler.get_typing_system().get_interned_types_count());
+}
+
+TEST(type_interning, equal_types_from_different_arguments_give_the_same_instance) {
+    ModuleCompiler compiler("types", "", false);
+    auto i32 = compiler.create_type<I32Type>();
+
+    // Looked up in different tables first, then found by their key
+    auto array = compiler.create_type<ArrayType>(i32, 4);
+    ASSERT_EQ(array, compiler.create_type<ArrayType>(i32, (size_t)4, false));
+
+    std::vector<const Type*> params = { i32 };
+    auto function = compiler.create_type<FunctionType>(i32, params);
+    ASSERT_EQ(function, compiler.create_type<FunctionType>(i32, params, false));
+}
+
+TEST(type_interning, different_types_give_different_instances) {
+    ModuleCompiler compiler("types", "", false);
+    auto i32 = compiler.create_type<I32Type>();
+    auto i64 = compiler.create_type<I64Type>();
+
+    ASSERT_NE((const Type*)i32, (const Type*)i64);
+    ASSERT_NE(compiler.create_type<PointerType>(i32), compiler.create_type<PointerType>(i64));
+    ASSERT_NE(compiler.create_type<ArrayType>(i32, 4), compiler.create_type<ArrayType>(i32, 5));
+    ASSERT_NE(compiler.create_type<PointerType>(compiler.create_type<PointerType>(i32)),
+              compiler.create_type<PointerType>(i32));
+}
+
+TEST(type_interning, each_module_has_its_own_types) {
+    ModuleCompiler first("first", "", false);
+    ModuleCompiler second("second", "", false);
+    auto i32 = first.create_type<I32Type>();
+    ASSERT_NE((const Type*)i32, (const Type*)second.create_type<I32Type>());
+    ASSERT_EQ(i32->compiler, &first);
+}
+
+}